@@ -3,27 +3,70 @@
 #include <iterator>
 #include <sstream>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
 
 parse_error::parse_error(const std::string& whatarg)
   : runtime_error(whatarg) {}
 
+static std::string at_position(const std::string& whatarg, size_t line, size_t column) {
+  std::ostringstream ss;
+  ss << line << ":" << column << ": " << whatarg;
+  return ss.str();
+}
+
+parse_error::parse_error(const std::string& whatarg, size_t line, size_t column)
+  : runtime_error(at_position(whatarg, line, column)), line(line), column(column) {}
+
 unexpected_eol::unexpected_eol()
   : parse_error("Unexpected EOL") {}
 
-Symbol::Base::~Base() {}
+unexpected_eol::unexpected_eol(size_t line, size_t column)
+  : parse_error("Unexpected EOL", line, column) {}
+
+uint32_t SymbolTable::intern(const std::string& name) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto it = this->ids.find(name);
+  if (it != this->ids.end()) return it->second;
+  uint32_t id = this->names.size();
+  assert(id < Symbol::var_tag);
+  this->names.push_back(name);
+  this->ids.emplace(name, id);
+  return id;
+}
 
-Symbol::Var::Var(std::string s): value(s) {}
+bool SymbolTable::contains(const std::string& name) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->ids.count(name) != 0;
+}
 
-bool Symbol::Var::operator==(const Symbol::Var& other) const {
-  return this->value == other.value;
+const std::string& SymbolTable::name(uint32_t id) const {
+  // deque elements do not move when names are appended
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->names[id];
 }
 
-bool Symbol::Var::operator!=(const Symbol::Var& other) const {
-  return this->value != other.value;
+size_t SymbolTable::size() const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->names.size();
+}
+
+SymbolTable& SymbolTable::global() {
+  static SymbolTable table;
+  return table;
+}
+
+Symbol::Var::Var(const std::string& s): id(SymbolTable::global().intern(s)) {}
+
+const std::string& Symbol::Var::name() const {
+  return SymbolTable::global().name(this->id);
 }
 
 bool Symbol::Var::operator<(const Symbol::Var& other) const {
-  return this->value < other.value;
+  if (this->id == other.id) return false;
+  return this->name() < other.name();
 }
 
 Symbol::Term::Term(char c): value(c) {}
@@ -40,89 +83,31 @@ bool Symbol::Term::operator<(const Symbol::Term& other) const {
   return this->value < other.value;
 }
 
-Symbol::Symbol(Var v): value(std::shared_ptr<Var>(new Var(v))) { }
-
-Symbol::Symbol(Term t): value(std::shared_ptr<Term>(new Term(t))) { }
-
-bool Symbol::is_var() const {
-  assert(this->value != nullptr);
-  return dynamic_cast<Symbol::Var*>(this->value.get()) != nullptr;
-}
-
-bool Symbol::is_term() const {
-  assert(this->value != nullptr);
-  return dynamic_cast<Symbol::Term*>(this->value.get()) != nullptr;
+Symbol::Var Symbol::as_var() const {
+  assert(this->is_var());
+  return Symbol::Var::from_id(this->value & ~var_tag);
 }
 
-const Symbol::Var& Symbol::as_var() const {
-  assert(this->value != nullptr);
-  return *dynamic_cast<Symbol::Var*>(this->value.get());
-}
-
-const Symbol::Term& Symbol::as_term() const {
-  assert(this->value != nullptr);
-  return *dynamic_cast<Symbol::Term*>(this->value.get());
-}
-
-Symbol Symbol::read(std::istream& is) {
-  auto la = is.peek();
-  if (la == EOF)
-    throw unexpected_eol();
-  if (std::isalpha(la))
-    return Symbol::read_var(is);
-  return Symbol::read_term(is);
-}
-
-Symbol::Var Symbol::read_var(std::istream& is) {
-  int la = is.peek();
-  if (la == EOF)
-    throw unexpected_eol();
-  if (!std::isalpha(la)) {
-    throw parse_error("expected an alphabet");
-  }
-  auto c = is.get();
-  if (c == EOF) throw unexpected_eol();
-  return Symbol::Var(std::string(1, c));
-}
-
-Symbol::Term Symbol::read_term(std::istream& is) {
-  auto la = is.peek();
-  if (la == EOF)
-    throw unexpected_eol();
-  static const char specialchars[] = {'+', '-', '*', '/', '(', ')'};
-  auto unexpected = std::find(std::begin(specialchars), std::end(specialchars), la) == std::end(specialchars);
-  if (!std::isdigit(la) && unexpected) {
-    throw parse_error("expected a special char or digits");
-  }
-  auto c = is.get();
-  if (c == EOF) throw unexpected_eol();
-  return Symbol::Term(c);
+Symbol::Term Symbol::as_term() const {
+  assert(this->is_term());
+  return Symbol::Term((char)this->value);
 }
 
 std::ostream& operator<<(std::ostream& os, const Symbol& symbol) {
   if (symbol.is_var()) {
     auto var = symbol.as_var();
-      os << "<" << var.value << ">";
+      os << "<" << var.name() << ">";
   } else {
     auto term = symbol.as_term();
-    os << term.value;
+    auto c = term.value;
+    if (std::isalpha((unsigned char)c) || c == '<' || c == '\\' || c == '@' || c == ' ' || c == '\t') {
+      os << '\\';
+    }
+    os << c;
   }
   return os;
 }
 
-bool Symbol::operator==(const Symbol& other) const {
-  if (this->is_var() && other.is_var()) {
-    return (this->as_var()) == (other.as_var());
-  } else if (this->is_term() && other.is_term()) {
-    return (this->as_term()) == (other.as_term());
-  }
-  return false;
-}
-
-bool Symbol::operator!=(const Symbol& other) const {
-  return !(*this == other);
-}
-
 bool Symbol::operator<(const Symbol& other) const {
   if (this->is_var() && other.is_var()) {
     return (this->as_var()) < (other.as_var());
@@ -134,7 +119,7 @@ bool Symbol::operator<(const Symbol& other) const {
   return false;
 }
 
-Prod::Prod(Symbol::Var lhs, std::vector<Symbol> rhs): lhs(lhs), rhs(rhs){}
+Prod::Prod(Symbol::Var lhs, Rhs rhs, float weight): lhs(lhs), rhs(rhs), weight(weight) {}
 
 bool Prod::is_epsilon() const {
   return this->rhs.size() == 0;
@@ -144,45 +129,151 @@ bool Prod::is_unit() const {
   return this->rhs.size() == 1 && this->rhs[0].is_var();
 }
 
-bool Prod::operator==(const Prod& other) const {
-  if (this->lhs != other.lhs) return false;
-  if (this->rhs.size() != other.rhs.size()) return false;
-  for (size_t i=0; i<this->rhs.size(); i++) {
-    if (this->rhs[i] != other.rhs[i]) {
+template<typename A, typename B>
+static bool prod_equal(const A& a, const B& b) {
+  if (a.lhs != b.lhs) return false;
+  if (a.rhs.size() != b.rhs.size()) return false;
+  for (size_t i=0; i<a.rhs.size(); i++) {
+    if (a.rhs[i] != b.rhs[i]) {
       return false;
     }
   }
   return true;
 }
 
+template<typename A, typename B>
+static bool prod_less(const A& a, const B& b) {
+  if (a.lhs < b.lhs) return true;
+  else if (a.lhs == b.lhs) {
+    for(size_t i=0; i < std::min(a.rhs.size(), b.rhs.size()); i++) {
+      if (a.rhs[i] < b.rhs[i]) { return true; }
+      else if (a.rhs[i] == b.rhs[i]) { continue; }
+      else return false;
+    }
+    if (a.rhs.size() < b.rhs.size()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Prod::operator==(const Prod& other) const {
+  return prod_equal(*this, other);
+}
+
 bool Prod::operator!=(const Prod& other) const {
   return !(*this == other);
 }
 
 bool Prod::operator<(const Prod& other) const {
-  if (this->lhs < other.lhs) return true;
-  else if (this->lhs == other.lhs) {
-    for(size_t i=0; i < std::min(this->rhs.size(), other.rhs.size()); i++) {
-      if (this->rhs[i] < other.rhs[i]) { return true; }
-      else if (this->rhs[i] == other.rhs[i]) { continue; }
-      else return false;
+  return prod_less(*this, other);
+}
+
+bool ProdView::is_epsilon() const {
+  return this->rhs.size() == 0;
+}
+
+bool ProdView::is_unit() const {
+  return this->rhs.size() == 1 && this->rhs[0].is_var();
+}
+
+Prod ProdView::to_prod() const {
+  return Prod(this->lhs, Prod::Rhs(this->rhs.begin(), this->rhs.end()), this->weight);
+}
+
+bool ProdView::operator==(const ProdView& other) const {
+  return prod_equal(*this, other);
+}
+
+bool ProdView::operator!=(const ProdView& other) const {
+  return !(*this == other);
+}
+
+bool ProdView::operator<(const ProdView& other) const {
+  return prod_less(*this, other);
+}
+
+bool prod_id_less(const ProdView& a, const ProdView& b) {
+  if (a.lhs.id != b.lhs.id) return a.lhs.id < b.lhs.id;
+  return std::lexicographical_compare(std::begin(a.rhs), std::end(a.rhs),
+                                      std::begin(b.rhs), std::end(b.rhs),
+                                      [](Symbol x, Symbol y) { return x.value < y.value; });
+}
+
+ProdArena::ProdArena(const std::vector<Prod>& prods) {
+  for (auto& prod: prods) {
+    this->push_back(prod);
+  }
+}
+
+void ProdArena::reserve(size_t prods, size_t symbols) {
+  this->entries.reserve(prods);
+  this->symbols.reserve(symbols);
+}
+
+void ProdArena::push_back(Symbol::Var lhs, const Symbol* rhs, size_t length, float weight) {
+  uint32_t offset = this->symbols.size();
+  auto data = this->symbols.data();
+  if (rhs >= data && rhs < data + this->symbols.size()) {
+    // copying one of our own rhs; the arena may move while growing
+    auto from = rhs - data;
+    for (size_t i=0; i<length; i++) {
+      this->symbols.push_back(this->symbols[from + i]);
     }
-    if (this->rhs.size() < other.rhs.size()) {
-      return true;
+  } else {
+    this->symbols.insert(this->symbols.end(), rhs, rhs + length);
+  }
+  this->entries.push_back(Entry { lhs, offset, (uint32_t)length, weight });
+}
+
+void ProdArena::normalize() {
+  this->sort(prod_id_less);
+  size_t kept = 0;
+  for (size_t i = 0; i < this->entries.size(); i++) {
+    auto& entry = this->entries[i];
+    if (kept > 0 && this->view(this->entries[kept - 1]) == this->view(entry)) {
+      auto& last = this->entries[kept - 1];
+      last.weight = std::max(last.weight, entry.weight);
+      continue;
     }
+    this->entries[kept++] = entry;
   }
-  return false;
+  this->entries.erase(this->entries.begin() + kept, this->entries.end());
+
+  std::vector<Symbol> packed;
+  packed.reserve(this->symbols.size());
+  for (auto& entry: this->entries) {
+    auto first = this->symbols.begin() + entry.offset;
+    entry.offset = packed.size();
+    packed.insert(packed.end(), first, first + entry.length);
+  }
+  this->symbols.swap(packed);
+}
+
+bool ProdArena::weighted() const {
+  return std::any_of(this->entries.begin(), this->entries.end(),
+                     [](const Entry& entry) { return entry.weight != 0; });
 }
 
-Prod Prod::read(std::istream& is) {
-  auto lhs = Symbol::read_var(is);
-  if (is.get() != ':') throw parse_error("expected ':'");
-  std::vector<Symbol> rhs;
-  while (is.peek() != EOF) {
-    auto symbol = Symbol::read(is);
-    rhs.push_back(symbol);
+uint32_t ProdArena::var_id_bound() const {
+  uint32_t bound = 0;
+  for (auto& entry : this->entries) {
+    bound = std::max(bound, entry.lhs.id + 1);
+  }
+  for (auto sym : this->symbols) {
+    if (sym.is_var()) bound = std::max(bound, sym.as_var().id + 1);
   }
-  return Prod(lhs, rhs);
+  return bound;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> ProdArena::lhs_ranges() const {
+  std::vector<std::pair<uint32_t, uint32_t>> ranges(this->var_id_bound(), { 0, 0 });
+  for (size_t i=0; i<this->entries.size(); i++) {
+    auto& range = ranges[this->entries[i].lhs.id];
+    if (range.first == range.second) range.first = i;
+    range.second = i + 1;
+  }
+  return ranges;
 }
 
 std::istream& safe_getline(std::istream& is, std::string& t)
@@ -219,45 +310,247 @@ std::istream& safe_getline(std::istream& is, std::string& t)
   }
 }
 
-static Prod read_line(std::istream& is) {
-  std::string line;
-  do {
-    safe_getline(is, line);
-    if (is.bad()) throw unexpected_eol();
-  } while (line.length() == 0);
-  auto ss = std::istringstream(line);
-  return Prod::read(ss);
-}
-
-std::ostream& operator<<(std::ostream& os, const Prod& prod) {
+template<typename P>
+static std::ostream& print_prod(std::ostream& os, const P& prod) {
   auto lhs = Symbol(prod.lhs);
   os << lhs << ":";
   for (auto s : prod.rhs) {
     os << s;
   }
+  if (prod.weight != 0) {
+    // enough digits for the weight to parse back to the same float
+    auto precision = os.precision(std::numeric_limits<float>::max_digits10);
+    os << " @" << prod.weight;
+    os.precision(precision);
+  }
   return os;
 }
 
-CFG::CFG(Symbol::Var start, std::vector<Prod> prods)
-  : start(start), prods(prods) { }
+std::ostream& operator<<(std::ostream& os, const Prod& prod) {
+  return print_prod(os, prod);
+}
+
+std::ostream& operator<<(std::ostream& os, const ProdView& prod) {
+  return print_prod(os, prod);
+}
+
+CFG::CFG(Symbol::Var start, ProdArena prods)
+  : start(start), prods(std::move(prods)) { }
 
 Symbol::Var CFG::new_id() {
-  std::stringstream ss;
-  ss << "C" << this->next_ids++;
-  return Symbol::Var(ss.str());
+  auto& table = SymbolTable::global();
+  std::string name;
+  do {
+    name = "C" + std::to_string(this->next_ids++);
+  } while (table.contains(name));
+  return Symbol::Var(name);
+}
+
+uint32_t CFG::var_id_bound() const {
+  return std::max(this->prods.var_id_bound(), this->start.id + 1);
+}
+
+CFG CFG::with_prods(ProdArena prods) const {
+  prods.normalize();
+  CFG result { this->start, std::move(prods) };
+  result.next_ids = this->next_ids;
+  return result;
+}
+
+namespace {
+/// Pointer scanner over an in-memory grammar. Tracks the line start so
+/// errors carry a line:column position.
+struct Scanner {
+  const char* cur;
+  const char* end;
+  const char* line_start;
+  size_t line = 1;
+  /// interned ids of single letter variables, 0 when not looked up yet
+  uint32_t letters[256] = {};
+  /// reused for bracketed names
+  std::string name;
+
+  Scanner(const char* cur, const char* end): cur(cur), end(end), line_start(cur) {}
+
+  [[noreturn]] void fail(const std::string& what) const {
+    if (at_eol()) throw unexpected_eol(line, cur - line_start + 1);
+    throw parse_error(what, line, cur - line_start + 1);
+  }
+  bool at_eol() const {
+    return cur == end || *cur == '\n' || *cur == '\r';
+  }
+  void skip_blanks() {
+    while (cur != end && (*cur == ' ' || *cur == '\t')) cur++;
+  }
+  void next_line() {
+    while (!at_eol()) cur++;
+    if (cur != end && *cur == '\r') cur++;
+    if (cur != end && *cur == '\n') cur++;
+    line++;
+    line_start = cur;
+  }
+  /// skips blank lines; false at the end of the buffer
+  bool next_nonblank_line() {
+    for (;;) {
+      skip_blanks();
+      if (cur == end) return false;
+      if (!at_eol()) return true;
+      next_line();
+    }
+  }
+
+  size_t count() {
+    if (cur == end || !std::isdigit((unsigned char)*cur)) fail("expected the number of productions");
+    auto first = cur;
+    size_t n = 0;
+    while (cur != end && std::isdigit((unsigned char)*cur)) {
+      size_t digit = *cur++ - '0';
+      if (n > (SIZE_MAX - digit) / 10) {
+        cur = first;
+        fail("number of productions out of range");
+      }
+      n = n * 10 + digit;
+    }
+    return n;
+  }
+
+  Symbol::Var var() {
+    if (cur == end) fail("expected a variable");
+    auto c = (unsigned char)*cur;
+    if (std::isalpha(c)) {
+      cur++;
+      if (letters[c] == 0) {
+        // ids start at 0, so store them shifted by one
+        letters[c] = SymbolTable::global().intern(std::string(1, c)) + 1;
+      }
+      return Symbol::Var::from_id(letters[c] - 1);
+    }
+    if (c != '<') fail("expected a variable");
+    auto first = ++cur;
+    while (!at_eol() && *cur != '>') cur++;
+    if (at_eol()) fail("expected '>'");
+    if (cur == first) fail("expected a variable name");
+    name.assign(first, cur++);
+    return Symbol::Var::from_id(SymbolTable::global().intern(name));
+  }
+
+  float weight() {
+    auto first = cur;
+    while (!at_eol() && *cur != ' ' && *cur != '\t') cur++;
+    std::string text(first, cur);
+    char* last;
+    auto w = std::strtof(text.c_str(), &last);
+    if (text.empty() || *last != '\0') {
+      cur = first;
+      fail("expected a weight");
+    }
+    // the Viterbi and inside closures rely on weights never increasing
+    if (!std::isfinite(w) || w > 0) {
+      cur = first;
+      fail("expected a finite log-probability <= 0");
+    }
+    return w;
+  }
+
+  Symbol symbol() {
+    auto c = (unsigned char)*cur;
+    if (std::isalpha(c) || c == '<') return var();
+    if (c == '\\') {
+      cur++;
+      if (at_eol()) fail("expected an escaped terminal");
+      return Symbol::Term(*cur++);
+    }
+    if (!std::isgraph(c) && c < 0x80) fail("expected a symbol");
+    cur++;
+    return Symbol::Term(c);
+  }
+};
+}
+
+CFG CFG::parse(const char*& cur, const char* end) {
+  Scanner in(cur, end);
+  if (!in.next_nonblank_line()) in.fail("expected the number of productions");
+  auto N = in.count();
+  in.skip_blanks();
+  if (!in.at_eol()) in.fail("expected end of line");
+  if (N == 0) in.fail("expected at least one production");
+  in.next_line();
+
+  // every production takes at least two bytes, so a count larger than
+  // the buffer allows fails on a missing production, not on the reserve
+  auto expected = std::min<size_t>(N, (end - in.cur) / 2);
+  ProdArena prods;
+  prods.reserve(expected, expected * 4);
+  Prod::Rhs rhs;
+  Symbol::Var start = Symbol::Var::from_id(0);
+  for (size_t i = 0; i < N; i++) {
+    if (!in.next_nonblank_line()) in.fail("expected a production");
+    auto lhs = in.var();
+    in.skip_blanks();
+    if (in.at_eol() || *in.cur != ':') in.fail("expected ':'");
+    in.cur++;
+    rhs.clear();
+    float weight = 0;
+    for (;;) {
+      in.skip_blanks();
+      if (in.at_eol()) break;
+      if (*in.cur == '@') {
+        in.cur++;
+        weight = in.weight();
+        in.skip_blanks();
+        if (!in.at_eol()) in.fail("expected end of line");
+        break;
+      }
+      rhs.push_back(in.symbol());
+    }
+    prods.push_back(lhs, rhs.data(), rhs.size(), weight);
+    if (i == 0) start = lhs;
+    in.next_line();
+  }
+  cur = in.cur;
+  return CFG(start, std::move(prods));
 }
 
 CFG CFG::read(std::istream& is) {
-  int N;
-  is >> N;
-  std::vector<Prod> prods;
-  auto first_prod = read_line(is);
-  prods.push_back(first_prod);
-  for (int i = 0; i < N-1; i++) {
-    auto prod = read_line(is);
-    prods.push_back(prod);
+  // Collect the count line and the production lines, blank ones included
+  // so that error lines match the input, then scan them in one go
+  std::string buffer, line;
+  long remaining = -1;
+  while (remaining != 0 && !safe_getline(is, line).eof()) {
+    buffer += line;
+    buffer += '\n';
+    if (line.find_first_not_of(" \t") == std::string::npos) continue;
+    if (remaining < 0) {
+      remaining = std::max(0L, std::strtol(line.c_str(), nullptr, 10));
+    } else {
+      remaining--;
+    }
+  }
+  const char* cur = buffer.data();
+  return CFG::parse(cur, buffer.data() + buffer.size());
+}
+
+std::string read_all(std::istream& is) {
+  std::string data;
+  char chunk[1 << 16];
+  while (is.read(chunk, sizeof chunk) || is.gcount() > 0) {
+    data.append(chunk, is.gcount());
+  }
+  return data;
+}
+
+std::vector<std::string> read_words(const char* cur, const char* end) {
+  std::vector<std::string> words;
+  while (cur != end) {
+    if (std::isspace((unsigned char)*cur)) { cur++; continue; }
+    auto first = cur;
+    while (cur != end && !std::isspace((unsigned char)*cur)) cur++;
+    words.emplace_back(first, cur);
+  }
+  if (words.empty()) {
+    words.push_back("");
   }
-  return CFG(first_prod.lhs, prods);
+  return words;
 }
 
 std::ostream& operator<<(std::ostream& os, const CFG& cfg) {
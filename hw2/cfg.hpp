@@ -2,20 +2,31 @@
 #define _CFG_H_
 
 #include <string>
-#include <memory>
+#include <deque>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include "small_vector.hpp"
 
 class parse_error : public std::runtime_error {
 public:
   explicit parse_error (const std::string& whatarg);
+  /// prefixes whatarg with "line:column: ", both 1-based
+  parse_error (const std::string& whatarg, size_t line, size_t column);
+  /// 0 when the position is unknown
+  size_t line = 0;
+  size_t column = 0;
 };
 
 class unexpected_eol : public parse_error {
 public:
   explicit unexpected_eol();
+  unexpected_eol(size_t line, size_t column);
 };
 
 #define DEF_CTR_ASSIGN(name) \
@@ -24,18 +35,43 @@ public:
   name& operator=(const name&) = default;\
   name& operator=(name&&) = default
 
+/// Interned variable names. There is one table for the whole process,
+/// shared by every grammar: a Var is a bare id, and its name, order and
+/// printed form all come from here. Names are never removed, so ids and
+/// the references name() returns stay valid until the program exits.
+/// Every member locks the table, so grammars may be read, printed or
+/// converted from several threads at once. Per-variable arrays of a pass
+/// are sized by CFG::var_id_bound(), not by size(), so they do not grow
+/// with names interned for other grammars.
+class SymbolTable {
+  std::deque<std::string> names;
+  std::unordered_map<std::string, uint32_t> ids;
+  mutable std::mutex lock;
+
+public:
+  uint32_t intern(const std::string&);
+  bool contains(const std::string&) const;
+  const std::string& name(uint32_t id) const;
+  size_t size() const;
+
+  static SymbolTable& global();
+};
+
 struct Symbol {
-  struct Base { virtual ~Base(); };
 public:
-  struct Var : public Base {
-    std::string value;
-    Var(std::string);
+  struct Var {
+    uint32_t id;
+    Var(const std::string&);
     DEF_CTR_ASSIGN(Var);
-    bool operator==(const Var&) const;
-    bool operator!=(const Var&) const;
+    static Var from_id(uint32_t id) { Var var; var.id = id; return var; }
+    const std::string& name() const;
+    bool operator==(const Var& other) const { return id == other.id; }
+    bool operator!=(const Var& other) const { return id != other.id; }
     bool operator<(const Var&) const;
+  private:
+    Var() {}
   };
-  struct Term : public Base {
+  struct Term {
     char value;
     Term(char);
     DEF_CTR_ASSIGN(Term);
@@ -44,25 +80,24 @@ public:
     bool operator<(const Term&) const;
   };
 
-  std::shared_ptr<Base> value;
+  /// tagged id: a variable id with var_tag set, or a terminal character
+  static const uint32_t var_tag = 0x80000000u;
+  uint32_t value;
 
-  Symbol(Var);
-  Symbol(Term);
+  Symbol(Var v): value(v.id | var_tag) {}
+  Symbol(Term t): value((unsigned char)t.value) {}
   DEF_CTR_ASSIGN(Symbol);
 
-  bool is_var() const;
-  bool is_term() const;
+  bool is_var() const { return (value & var_tag) != 0; }
+  bool is_term() const { return (value & var_tag) == 0; }
 
-  const Symbol::Var& as_var() const;
-  const Symbol::Term& as_term() const;
+  Symbol::Var as_var() const;
+  Symbol::Term as_term() const;
 
-  static Symbol read(std::istream&);
-  static Symbol::Var read_var(std::istream&);
-  static Symbol::Term read_term(std::istream&);
   friend std::ostream& operator<<(std::ostream&, const Symbol&);
 
-  bool operator==(const Symbol&) const;
-  bool operator!=(const Symbol&) const;
+  bool operator==(const Symbol& other) const { return value == other.value; }
+  bool operator!=(const Symbol& other) const { return value != other.value; }
   bool operator<(const Symbol&) const;
 };
 
@@ -71,7 +106,7 @@ std::ostream& operator<<(std::ostream&, const Symbol&);
 namespace std {
 template<> struct hash<Symbol::Var> {
   size_t operator()(const Symbol::Var &var) const {
-    return std::hash<std::string>()(var.value);
+    return var.id;
   }
 };
 
@@ -83,18 +118,19 @@ template<> struct hash<Symbol::Term> {
 
 template<> struct hash<Symbol> {
   size_t operator()(const Symbol &sym) const {
-    if (sym.is_term())
-      return std::hash<Symbol::Term>()(sym.as_term());
-    else
-      return std::hash<Symbol::Var>()(sym.as_var());
+    return sym.value;
   }
 };
 };
 struct Prod {
+  using Rhs = SmallVector<Symbol, 4>;
+
   Symbol::Var lhs;
-  std::vector<Symbol> rhs;
+  Rhs rhs;
+  /// log-probability; 0 in unweighted grammars
+  float weight = 0;
 
-  Prod(Symbol::Var, std::vector<Symbol> rhs);
+  Prod(Symbol::Var, Rhs rhs, float weight = 0);
   DEF_CTR_ASSIGN(Prod);
 
   bool is_epsilon() const;
@@ -104,11 +140,11 @@ struct Prod {
   bool operator!=(const Prod&) const;
   bool operator<(const Prod&) const;
 
-  static Prod read(std::istream&);
   friend std::ostream& operator<<(std::ostream&, const Prod&);
 };
 
 std::ostream& operator<<(std::ostream&, const Prod&);
+
 namespace std {
 template<> struct hash<Prod> {
   size_t operator()(const Prod &prod) const {
@@ -121,19 +157,155 @@ template<> struct hash<Prod> {
 };
 }
 
+/// Read-only view of a right-hand side stored in a ProdArena
+struct RhsView {
+  const Symbol* first;
+  const Symbol* last;
+
+  size_t size() const { return last - first; }
+  bool empty() const { return first == last; }
+  const Symbol& operator[](size_t i) const { return first[i]; }
+  const Symbol* begin() const { return first; }
+  const Symbol* end() const { return last; }
+};
+
+/// A production stored in a ProdArena. Valid until the arena is modified.
+struct ProdView {
+  Symbol::Var lhs;
+  RhsView rhs;
+  float weight;
+
+  bool is_epsilon() const;
+  bool is_unit() const;
+  Prod to_prod() const;
+
+  bool operator==(const ProdView&) const;
+  bool operator!=(const ProdView&) const;
+  bool operator<(const ProdView&) const;
+};
+
+std::ostream& operator<<(std::ostream&, const ProdView&);
+
+/// Orders by interned ids; cheaper than ProdView::operator< which compares
+/// names. Use it where the order only has to be consistent, e.g. deduplication.
+bool prod_id_less(const ProdView&, const ProdView&);
+
+/// Productions of a grammar in flat storage. Every rhs lives in one
+/// contiguous symbol arena and a production is an (lhs, offset, length)
+/// record into it. Transformation passes build a fresh arena for the
+/// grammar they produce instead of copying productions around.
+class ProdArena {
+  struct Entry {
+    Symbol::Var lhs;
+    uint32_t offset;
+    uint32_t length;
+    float weight;
+  };
+  std::vector<Symbol> symbols;
+  std::vector<Entry> entries;
+
+  ProdView view(const Entry& entry) const {
+    auto first = symbols.data() + entry.offset;
+    return ProdView { entry.lhs, RhsView { first, first + entry.length }, entry.weight };
+  }
+
+public:
+  class iterator {
+    const ProdArena* arena;
+    size_t i;
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ProdView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ProdView*;
+    using reference = ProdView;
+
+    iterator(const ProdArena* arena, size_t i): arena(arena), i(i) {}
+    ProdView operator*() const { return (*arena)[i]; }
+    iterator& operator++() { i++; return *this; }
+    bool operator==(const iterator& other) const { return i == other.i; }
+    bool operator!=(const iterator& other) const { return i != other.i; }
+  };
+
+  ProdArena() {}
+  ProdArena(const std::vector<Prod>&);
+  DEF_CTR_ASSIGN(ProdArena);
+
+  size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+  ProdView operator[](size_t i) const { return view(entries[i]); }
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, entries.size()); }
+
+  void reserve(size_t prods, size_t symbols);
+  void push_back(Symbol::Var lhs, const Symbol* rhs, size_t length, float weight = 0);
+  void push_back(Symbol::Var lhs, RhsView rhs, float weight = 0) {
+    push_back(lhs, rhs.first, rhs.size(), weight);
+  }
+  void push_back(Symbol::Var lhs, std::initializer_list<Symbol> rhs, float weight = 0) {
+    push_back(lhs, rhs.begin(), rhs.size(), weight);
+  }
+  void push_back(ProdView prod) { push_back(prod.lhs, prod.rhs, prod.weight); }
+  void push_back(const Prod& prod) {
+    push_back(prod.lhs, prod.rhs.data(), prod.rhs.size(), prod.weight);
+  }
+
+  /// Reorders productions; their rhs stay where they are in the arena
+  template<typename Less>
+  void sort(Less less) {
+    std::sort(entries.begin(), entries.end(), [&](const Entry& a, const Entry& b) {
+        return less(view(a), view(b));
+      });
+  }
+  /// Sorts by prod_id_less and drops duplicates, keeping the highest
+  /// weight, so the productions of a variable are adjacent. The arena is
+  /// repacked in the new order.
+  void normalize();
+  bool weighted() const;
+  /// one past the largest variable id on either side of a production
+  uint32_t var_id_bound() const;
+  /// [first, last) production indices of every variable, indexed by its
+  /// interned id up to var_id_bound(). Only meaningful after normalize().
+  std::vector<std::pair<uint32_t, uint32_t>> lhs_ranges() const;
+};
+
+/// Input format: a production count line, then that many production lines
+/// `lhs:rhs`; blank lines are skipped. A variable is a single letter or a
+/// bracketed name such as <Expr>. Any other printable or non-ASCII byte is
+/// a terminal; `\c` makes c a terminal even if it is a letter, '<', '\',
+/// '@' or a blank. Blanks between symbols are ignored. A production may end
+/// with `@w`, its log-probability w, which must be finite and <= 0. The
+/// first lhs is the start symbol.
 struct CFG {
   Symbol::Var start;
-  std::vector<Prod> prods;
+  ProdArena prods;
   int next_ids = 0;
 
-  CFG(Symbol::Var, std::vector<Prod>);
+  CFG(Symbol::Var, ProdArena);
   DEF_CTR_ASSIGN(CFG);
 
+  /// a fresh variable "C<n>" whose name is not interned yet
   Symbol::Var new_id();
+  /// one past the largest variable id in the grammar, start included;
+  /// the size of per-variable arrays
+  uint32_t var_id_bound() const;
+  /// the grammar with the same start symbol and fresh name counter but
+  /// prods instead, normalized; what every transformation pass returns
+  CFG with_prods(ProdArena prods) const;
 
+  /// Reads exactly the grammar's lines and leaves the rest of the stream
   static CFG read(std::istream&);
+  /// Scans a grammar from [cur, end) and advances cur to the line after it
+  static CFG parse(const char*& cur, const char* end);
   friend std::ostream& operator<<(std::ostream&, const CFG&);
 };
 
 std::ostream& operator<<(std::ostream&, const CFG&);
+
+/// The rest of the stream in one buffer, for CFG::parse
+std::string read_all(std::istream&);
+
+/// The whitespace separated words in [first, last), what the tools read
+/// after the grammar; one empty word if there are none
+std::vector<std::string> read_words(const char* first, const char* last);
 #endif
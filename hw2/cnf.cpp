@@ -5,6 +5,8 @@
 using namespace std;
 
 int main() {
-  auto cfg = CFG::read(cin);
+  auto input = read_all(cin);
+  const char* cur = input.data();
+  auto cfg = CFG::parse(cur, input.data() + input.size());
   cout << to_cnf(cfg);
 }
@@ -0,0 +1,138 @@
+#include "compiled_cnf.hpp"
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+#define RANGE(x) begin(x), end(x)
+
+bool is_cnf(const CFG& cfg) {
+  for(auto prod: cfg.prods) {
+    if (prod.rhs.size() == 1 && prod.rhs[0].is_term()) continue;
+    if (prod.rhs.size() == 2 && prod.rhs[0].is_var() && prod.rhs[1].is_var()) continue;
+    return false;
+  }
+  return true;
+}
+
+void Chart::reset(size_t n, size_t words) {
+  this->n = n;
+  this->words = words;
+  this->bits.assign(n * n * words, 0);
+}
+
+CompiledCNF::CompiledCNF(const CFG& cfg) {
+  if (!is_cnf(cfg)) {
+    throw runtime_error("out of homework specification. input must be a CNF");
+  }
+  vector<int> index(cfg.var_id_bound(), -1);
+  auto index_var = [&](Symbol::Var var) {
+    if (index[var.id] < 0) {
+      index[var.id] = vars.size();
+      vars.push_back(var);
+    }
+    return index[var.id];
+  };
+  start = index_var(cfg.start);
+  for(auto prod: cfg.prods) {
+    index_var(prod.lhs);
+    for(auto sym: prod.rhs) {
+      if (sym.is_var()) index_var(sym.as_var());
+    }
+  }
+  words = (vars.size() + 63) / 64;
+
+  term_cells.assign(256 * words, 0);
+  vector<vector<pair<uint32_t, uint32_t>>> by_left(vars.size());
+  for(auto prod: cfg.prods) {
+    uint32_t A = index[prod.lhs.id];
+    if (prod.rhs.size() == 1) {
+      auto c = (unsigned char)prod.rhs[0].as_term().value;
+      term_cells[c * words + A / 64] |= (uint64_t)1 << (A % 64);
+      continue;
+    }
+    auto B = index[prod.rhs[0].as_var().id];
+    auto C = index[prod.rhs[1].as_var().id];
+    by_left[B].push_back({ C, A });
+  }
+  for(auto& rules: by_left) {
+    left_begin.push_back(rule_right.size());
+    sort(RANGE(rules));
+    for(auto rule: rules) {
+      rule_right.push_back(rule.first);
+      rule_lhs.push_back(rule.second);
+    }
+  }
+  left_begin.push_back(rule_right.size());
+}
+
+void CompiledCNF::combine(const uint64_t* left, const uint64_t* right, uint64_t* cell) const {
+  for(size_t w=0; w<words; w++) {
+    for(auto bits = left[w]; bits; bits &= bits - 1) {
+      auto B = w * 64 + __builtin_ctzll(bits);
+      for(auto r = left_begin[B]; r < left_begin[B + 1]; r++) {
+        auto C = rule_right[r];
+        if ((right[C / 64] >> (C % 64)) & 1) {
+          auto A = rule_lhs[r];
+          cell[A / 64] |= (uint64_t)1 << (A % 64);
+        }
+      }
+    }
+  }
+}
+
+bool CompiledCNF::recognize(const string& a, Chart& chart) const {
+  auto n = a.size();
+  if (n == 0) return false;
+  chart.reset(n, words);
+  // V_ii = { A: A->a_i }
+  for(size_t i=0; i<n; i++) {
+    copy_n(term_cell(a[i]), words, chart.cell(i, 1));
+  }
+  for(size_t len=2; len<=n; len++) {
+    for(size_t i=0; i + len <= n; i++) {
+      // V_ij = V_ij U { A: A->BC, B in V_ik, C in V_(k+1)j }
+      auto cell = chart.cell(i, len);
+      for(size_t k=1; k<len; k++) {
+        combine(chart.cell(i, k), chart.cell(i + k, len - k), cell);
+      }
+    }
+  }
+  // S in V_1n
+  return accepts(chart.cell(0, n));
+}
+
+bool CompiledCNF::recognize(const string& a) const {
+  Chart chart;
+  return recognize(a, chart);
+}
+
+vector<bool> CompiledCNF::recognize_batch(const vector<string>& inputs, unsigned threads) const {
+  vector<char> results(inputs.size(), 0);
+  atomic<size_t> next(0);
+  auto worker = [&]() {
+    Chart chart;
+    for(;;) {
+      auto i = next.fetch_add(1);
+      if (i >= inputs.size()) return;
+      results[i] = recognize(inputs[i], chart);
+    }
+  };
+  threads = max(1u, min<unsigned>(threads, inputs.size()));
+  vector<thread> pool;
+  for(unsigned t=1; t<threads; t++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for(auto& t: pool) {
+    t.join();
+  }
+  return vector<bool>(RANGE(results));
+}
+
+bool cyk(const CFG& cfg, const string& a) {
+  return CompiledCNF(cfg).recognize(a);
+}
@@ -0,0 +1,64 @@
+#include "cfg.hpp"
+
+#ifndef _COMPILED_CNF_
+#define _COMPILED_CNF_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+bool is_cnf(const CFG& cfg);
+
+/// CYK chart storage, reusable between strings.
+/// Cell (i, len) is a bitset over variables, `words` 64-bit words long.
+struct Chart {
+  size_t n = 0;
+  size_t words = 0;
+  std::vector<uint64_t> bits;
+
+  void reset(size_t n, size_t words);
+
+  uint64_t* cell(size_t i, size_t len) {
+    return &bits[((len - 1) * n + i) * words];
+  }
+  const uint64_t* cell(size_t i, size_t len) const {
+    return &bits[((len - 1) * n + i) * words];
+  }
+};
+
+/// A CNF grammar preprocessed once for CYK recognition: variables are
+/// numbered densely, A -> a rules become a per-character bitset and
+/// A -> BC rules are grouped by B.
+struct CompiledCNF {
+  std::vector<Symbol::Var> vars;
+  int start = -1;
+  size_t words = 0;
+  /// 256 cells of `words` words, the variables deriving each character
+  std::vector<uint64_t> term_cells;
+  /// rules with left child B are [left_begin[B], left_begin[B+1])
+  std::vector<uint32_t> left_begin;
+  std::vector<uint32_t> rule_right;
+  std::vector<uint32_t> rule_lhs;
+
+  /// throws std::runtime_error if the grammar is not in CNF
+  explicit CompiledCNF(const CFG&);
+
+  bool recognize(const std::string&) const;
+  /// fills `chart` for the whole string
+  bool recognize(const std::string&, Chart& chart) const;
+  /// recognizes every string with `threads` workers, each owning one chart
+  std::vector<bool> recognize_batch(const std::vector<std::string>&, unsigned threads) const;
+
+  const uint64_t* term_cell(char c) const {
+    return &term_cells[(unsigned char)c * words];
+  }
+  /// cell |= { A: A -> BC, B in left, C in right }
+  void combine(const uint64_t* left, const uint64_t* right, uint64_t* cell) const;
+  bool accepts(const uint64_t* cell) const {
+    return start >= 0 && (cell[start / 64] >> (start % 64)) & 1;
+  }
+};
+
+bool cyk(const CFG& cfg, const std::string& a);
+
+#endif
@@ -0,0 +1,43 @@
+#include "cfg.hpp"
+#include "to_cnf.hpp"
+#include "compiled_cnf.hpp"
+#include "incremental_cyk.hpp"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/// usage: cyk_edit [+]
+/// Reads the grammar and an initial word, then edit commands:
+///   i <pos> <char>   insert before pos
+///   d <pos>          delete
+///   r <pos> <char>   replace
+/// and prints Yes/No for the initial word and after every edit.
+int main(int argc, char *argv[]) {
+  const CFG cfg = CFG::read(std::cin);
+  const CFG cnf = argc > 1 && strcmp(argv[1], "+") == 0 ? to_cnf(cfg) : cfg;
+  const CompiledCNF compiled(cnf);
+
+  string str;
+  cin >> str;
+  IncrementalCYK chart(compiled, str);
+  std::cout << (chart.accepted()?"Yes":"No") << "\n";
+
+  char op, c;
+  size_t pos;
+  while (cin >> op >> pos) {
+    if (op == 'd') {
+      if (pos >= chart.input.size()) throw runtime_error("position out of range");
+      chart.erase(pos);
+    } else if (op == 'i' || op == 'r') {
+      cin >> c;
+      if (pos > chart.input.size() || (op == 'r' && pos == chart.input.size()))
+        throw runtime_error("position out of range");
+      if (op == 'i') chart.insert(pos, c);
+      else chart.replace(pos, c);
+    } else {
+      throw runtime_error("unknown edit command");
+    }
+    std::cout << (chart.accepted()?"Yes":"No") << "\n";
+  }
+}
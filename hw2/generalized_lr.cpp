@@ -0,0 +1,253 @@
+#include "generalized_lr.hpp"
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+using Kind = LRTable::Kind;
+using Action = LRTable::Action;
+#define RANGE(x) begin(x), end(x)
+
+GLRParser::GLRParser(const LRTable& table): table(table) {
+  for (auto& conflict: table.conflicts) {
+    auto key = conflict.state * (int)table.terms.size() + conflict.term;
+    rejected[key].push_back(conflict.rejected);
+  }
+}
+
+void GLRParser::actions(int state, int term, vector<Action>& out) const {
+  out.clear();
+  auto a = table.action(state, term);
+  if (a.kind == Kind::Error) return;
+  out.push_back(a);
+  auto it = rejected.find(state * (int)table.terms.size() + term);
+  if (it != end(rejected)) {
+    out.insert(end(out), RANGE(it->second));
+  }
+}
+
+namespace {
+
+struct Edge {
+  int to;
+  /// forest node of the symbol the edge stands for
+  int label;
+};
+
+struct StackNode {
+  int state;
+  size_t pos;
+  vector<Edge> edges;
+};
+
+/// Reduce `prod` on paths from `node`. After an edge is added to a node
+/// that was already reduced, only the paths through that edge are new.
+struct Reduction {
+  int node;
+  int prod;
+  int edge_from;
+  int edge_to;
+};
+
+struct Run {
+  const GLRParser& parser;
+  const LRTable& table;
+  Forest& forest;
+
+  vector<StackNode> stack;
+  /// nodes at the current position, and the node of each state
+  vector<int> frontier;
+  vector<int> by_state;
+  /// (symbol, start) -> forest node ending at the current position
+  unordered_map<uint64_t, int> labels;
+  size_t pos = 0;
+  int term = 0;
+  vector<Reduction> work;
+  vector<int> path;
+  vector<Action> acts;
+
+  Run(const GLRParser& parser, Forest& forest)
+    : parser(parser), table(parser.table), forest(forest),
+      by_state(parser.table.num_states, -1) {}
+
+  int add_node(int state) {
+    stack.push_back(StackNode { state, pos, {} });
+    int node = stack.size() - 1;
+    frontier.push_back(node);
+    by_state[state] = node;
+    return node;
+  }
+
+  int symbol_node(int symbol, size_t start) {
+    auto key = (uint64_t)(uint32_t)symbol << 32 | start;
+    auto it = labels.find(key);
+    if (it != end(labels)) return it->second;
+    forest.nodes.push_back(Forest::Node { symbol, start, pos, {} });
+    int node = forest.nodes.size() - 1;
+    labels.emplace(key, node);
+    return node;
+  }
+
+  void add_packed(int node, int prod, const vector<int>& children) {
+    for (auto p: forest.nodes[node].packed) {
+      auto& alt = forest.packed[p];
+      if (alt.prod == prod && alt.children == children) return;
+    }
+    forest.packed.push_back(Forest::Packed { prod, children });
+    forest.nodes[node].packed.push_back(forest.packed.size() - 1);
+  }
+
+  void queue_reductions(int node, int edge_from, int edge_to) {
+    parser.actions(stack[node].state, term, acts);
+    for (auto a: acts) {
+      if (a.kind != Kind::Reduce) continue;
+      if (edge_from >= 0 && table.prod_len[a.value] == 0) continue;
+      work.push_back(Reduction { node, a.value, edge_from, edge_to });
+    }
+  }
+
+  /// walks `left` more edges from `node`; `path` holds the labels so far
+  void walk(int node, int left, const Reduction& r, bool used) {
+    if (left == 0) {
+      if (used) reduce_path(node, r.prod);
+      return;
+    }
+    // edges may be added below, so iterate by index
+    for (size_t e = 0; e < stack[node].edges.size(); e++) {
+      auto edge = stack[node].edges[e];
+      path.push_back(edge.label);
+      walk(edge.to, left - 1, r, used || (node == r.edge_from && edge.to == r.edge_to));
+      path.pop_back();
+    }
+  }
+
+  void reduce_path(int target, int prod) {
+    auto A = table.prod_lhs[prod];
+    vector<int> children(path.rbegin(), path.rend());
+    auto label = symbol_node(~A, stack[target].pos);
+    add_packed(label, prod, children);
+
+    auto state = table.go(stack[target].state, A);
+    auto node = by_state[state];
+    if (node < 0) {
+      node = add_node(state);
+      stack[node].edges.push_back(Edge { target, label });
+      queue_reductions(node, -1, -1);
+      return;
+    }
+    for (auto& edge: stack[node].edges) {
+      if (edge.to == target) return;
+    }
+    stack[node].edges.push_back(Edge { target, label });
+    for (auto other: frontier) {
+      queue_reductions(other, node, target);
+    }
+  }
+
+  void reduce_all() {
+    for (auto node: frontier) {
+      queue_reductions(node, -1, -1);
+    }
+    while (!work.empty()) {
+      auto r = work.back();
+      work.pop_back();
+      walk(r.node, table.prod_len[r.prod], r, r.edge_from < 0);
+    }
+  }
+
+  /// moves the frontier past the current character; it ends up empty when
+  /// no branch can shift it
+  void shift_all() {
+    auto label = (int)forest.nodes.size();
+    forest.nodes.push_back(Forest::Node { term, pos, pos + 1, {} });
+
+    auto current = move(frontier);
+    frontier.clear();
+    for (auto node: current) {
+      by_state[stack[node].state] = -1;
+    }
+    labels.clear();
+    pos++;
+    for (auto node: current) {
+      parser.actions(stack[node].state, term, acts);
+      for (auto a: acts) {
+        if (a.kind != Kind::Shift) continue;
+        auto next = by_state[a.value];
+        if (next < 0) next = add_node(a.value);
+        stack[next].edges.push_back(Edge { node, label });
+      }
+    }
+  }
+
+  int accepting_root() {
+    for (auto node: frontier) {
+      parser.actions(stack[node].state, 0, acts);
+      for (auto a: acts) {
+        if (a.kind != Kind::Accept) continue;
+        for (auto& edge: stack[node].edges) {
+          if (edge.to == 0) return edge.label;
+        }
+      }
+    }
+    return -1;
+  }
+};
+
+}
+
+bool GLRParser::parse(const string& input, Forest* forest) const {
+  Forest local;
+  Run run(*this, forest ? *forest : local);
+  run.forest = Forest();
+  run.add_node(0);
+  for (size_t i = 0; i <= input.size(); i++) {
+    run.term = 0;
+    if (i < input.size()) {
+      run.term = table.term_index[(unsigned char)input[i]];
+      if (run.term < 0) return false;
+    }
+    run.reduce_all();
+    if (i == input.size()) break;
+    run.shift_all();
+    if (run.frontier.empty()) return false;
+  }
+  run.forest.root = run.accepting_root();
+  return run.forest.root >= 0;
+}
+
+static void print_node(ostream& os, const LRTable& table, const vector<Symbol>& vars,
+                       const Forest::Node& node) {
+  if (node.symbol < 0) os << vars[~node.symbol];
+  else os << Symbol(Symbol::Term(table.terms[node.symbol]));
+  os << "[" << node.start << "," << node.end << "]";
+}
+
+void Forest::print(ostream& os, const LRTable& table) const {
+  auto num_vars = *max_element(RANGE(table.prod_lhs)) + 1;
+  vector<Symbol> vars(num_vars, Symbol(Symbol::Term(0)));
+  for (size_t p = 0; p < table.prods.size(); p++) {
+    vars[table.prod_lhs[p]] = table.prods[p].lhs;
+  }
+  if (root < 0) return;
+  vector<bool> seen(nodes.size(), false);
+  vector<int> todo { root };
+  seen[root] = true;
+  while (!todo.empty()) {
+    auto n = todo.back();
+    todo.pop_back();
+    for (auto p: nodes[n].packed) {
+      print_node(os, table, vars, nodes[n]);
+      os << ":";
+      for (auto child: packed[p].children) {
+        os << " ";
+        print_node(os, table, vars, nodes[child]);
+        if (!seen[child]) {
+          seen[child] = true;
+          todo.push_back(child);
+        }
+      }
+      os << "\n";
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#include "cfg.hpp"
+#include "lalr.hpp"
+
+#ifndef _GENERALIZED_LR_
+#define _GENERALIZED_LR_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+
+/// Shared packed parse forest. A symbol node covers the input [start, end);
+/// each packed alternative under it is one production with its children.
+/// Symbols use the LRTable encoding: a terminal column (>= 0) or ~var.
+struct Forest {
+  struct Node {
+    int symbol;
+    size_t start;
+    size_t end;
+    std::vector<int> packed;
+  };
+  struct Packed {
+    int prod;
+    std::vector<int> children;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<Packed> packed;
+  int root = -1;
+
+  /// one line per packed alternative reachable from the root
+  void print(std::ostream&, const LRTable&) const;
+};
+
+/// Tomita-style generalized LR over an LALR(1) table. Where the table has a
+/// conflict every action is followed, on a graph-structured stack whose
+/// branches merge again on equal states; deterministic stretches of the
+/// input cost the same as LRTable::parse.
+class GLRParser {
+public:
+  explicit GLRParser(const LRTable&);
+
+  /// fills `forest` when the input is accepted and a forest is asked for
+  bool parse(const std::string&, Forest* forest = nullptr) const;
+  /// every action of a table entry, the table's own choice first
+  void actions(int state, int term, std::vector<LRTable::Action>& out) const;
+
+  const LRTable& table;
+
+private:
+  /// actions the table rejected in its conflicts, by state * terms + term
+  std::unordered_map<int, std::vector<LRTable::Action>> rejected;
+};
+
+#endif
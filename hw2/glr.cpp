@@ -0,0 +1,34 @@
+#include "cfg.hpp"
+#include "lalr.hpp"
+#include "generalized_lr.hpp"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/// usage: glr [-f]
+/// Like cyk, recognizes every whitespace separated word after the grammar,
+/// but needs no CNF and accepts any grammar. -f prints the parse forest
+/// after every Yes.
+int main(int argc, char *argv[]) {
+  bool print_forest = argc > 1 && strcmp(argv[1], "-f") == 0;
+
+  auto input = read_all(std::cin);
+  const char* cur = input.data();
+  const char* end = cur + input.size();
+  const CFG cfg = CFG::parse(cur, end);
+  auto inputs = read_words(cur, end);
+
+  auto table = LRTable::build(cfg);
+  GLRParser parser(table);
+  Forest forest;
+  for (size_t i=0; i<inputs.size(); i++) {
+    if (i > 0) std::cout << "\n";
+    auto accepted = parser.parse(inputs[i], &forest);
+    std::cout << (accepted?"Yes":"No");
+    if (accepted && print_forest) {
+      std::cout << "\n";
+      forest.print(std::cout, table);
+    }
+  }
+}
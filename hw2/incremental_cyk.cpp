@@ -0,0 +1,74 @@
+#include "incremental_cyk.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+IncrementalCYK::IncrementalCYK(const CompiledCNF& grammar, const string& input)
+  : grammar(grammar) {
+  assign(input);
+}
+
+void IncrementalCYK::assign(const string& input) {
+  this->input = input;
+  rows.assign(input.size(), {});
+  fit_rows();
+  rebuild(0, (long)input.size() - 1);
+}
+
+void IncrementalCYK::insert(size_t pos, char c) {
+  assert(pos <= input.size());
+  input.insert(begin(input) + pos, c);
+  rows.insert(begin(rows) + pos, vector<uint64_t>());
+  fit_rows();
+  rebuild(pos, pos);
+}
+
+void IncrementalCYK::erase(size_t pos) {
+  assert(pos < input.size());
+  input.erase(begin(input) + pos);
+  rows.erase(begin(rows) + pos);
+  fit_rows();
+  // spans joining the characters on both sides of the removed one
+  rebuild(pos, (long)pos - 1);
+}
+
+void IncrementalCYK::replace(size_t pos, char c) {
+  assert(pos < input.size());
+  input[pos] = c;
+  rebuild(pos, pos);
+}
+
+bool IncrementalCYK::accepted() const {
+  if (input.empty()) return false;
+  auto words = grammar.words;
+  return grammar.accepts(&rows[0][(input.size() - 1) * words]);
+}
+
+void IncrementalCYK::fit_rows() {
+  auto n = input.size();
+  for (size_t i = 0; i < n; i++) {
+    rows[i].resize((n - i) * grammar.words, 0);
+  }
+}
+
+void IncrementalCYK::rebuild(long lo, long hi) {
+  long n = input.size();
+  auto words = grammar.words;
+  for (long len = 1; len <= n; len++) {
+    auto first = max(0L, lo - len + 1);
+    auto last = min(hi, n - len);
+    for (long i = first; i <= last; i++) {
+      auto target = cell(i, len);
+      if (len == 1) {
+        copy_n(grammar.term_cell(input[i]), words, target);
+        continue;
+      }
+      fill_n(target, words, 0);
+      for (long k = 1; k < len; k++) {
+        grammar.combine(cell(i, k), cell(i + k, len - k), target);
+      }
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#include "compiled_cnf.hpp"
+
+#ifndef _INCREMENTAL_CYK_
+#define _INCREMENTAL_CYK_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// CYK chart kept alive across edits of the input. An edit at p only
+/// recomputes the cells whose span covers p; every other cell is kept,
+/// shifted along with its row. A recomputed cell still tries all of its
+/// splits, so an edit is O(n²) only near either end of the input and
+/// O(n³) in the worst case: an edit in the middle redoes about 3/4 of a
+/// full parse, one at a tenth of the way about 1/4.
+struct IncrementalCYK {
+  const CompiledCNF& grammar;
+  std::string input;
+  /// rows[i] holds cells (i, 1) .. (i, n-i), `grammar.words` words each
+  std::vector<std::vector<uint64_t>> rows;
+
+  IncrementalCYK(const CompiledCNF&, const std::string& = "");
+
+  void assign(const std::string&);
+  void insert(size_t pos, char c);
+  void erase(size_t pos);
+  void replace(size_t pos, char c);
+
+  bool accepted() const;
+
+private:
+  uint64_t* cell(size_t i, size_t len) {
+    return &rows[i][(len - 1) * grammar.words];
+  }
+  /// resizes rows to the current input length
+  void fit_rows();
+  /// recomputes cells (i, len) with i <= hi and i+len-1 >= lo
+  void rebuild(long lo, long hi);
+};
+
+#endif
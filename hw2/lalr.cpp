@@ -0,0 +1,471 @@
+#include "lalr.hpp"
+#include "cfg.hpp"
+
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+using namespace std;
+using Var = Symbol::Var;
+using Term = Symbol::Term;
+#define RANGE(x) begin(x), end(x)
+
+namespace {
+
+struct Bits {
+  vector<uint64_t> words;
+
+  explicit Bits(size_t n = 0): words((n + 63) / 64, 0) {}
+
+  void set(size_t i) { words[i / 64] |= (uint64_t)1 << (i % 64); }
+  bool test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+
+  /// this |= other, returns whether any bit is newly set
+  bool merge(const Bits& other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+      auto merged = words[i] | other.words[i];
+      if (merged != words[i]) { words[i] = merged; changed = true; }
+    }
+    return changed;
+  }
+};
+
+/// Grammar symbols are encoded as terminal columns (>= 0) or ~var (< 0).
+bool is_var(int sym) { return sym < 0; }
+int var_of(int sym) { return ~sym; }
+
+struct Grammar {
+  int num_vars = 0;
+  int num_terms = 0;
+  vector<int> lhs;
+  vector<vector<int>> rhs;
+  vector<vector<int>> by_lhs;
+  /// FIRST and nullability of every suffix rhs[p][dot..]
+  vector<vector<Bits>> first_suffix;
+  vector<vector<bool>> nullable_suffix;
+};
+
+struct Item {
+  int prod;
+  int dot;
+  /// goto state and slot of the item with the dot advanced
+  int next = -1;
+  int next_slot = -1;
+  /// slots of B -> .x items generated when the dot is before a variable B
+  int expand_begin = 0;
+  int expand_end = 0;
+};
+
+struct State {
+  vector<pair<int, int>> kernel;
+  vector<Item> items;
+  vector<Bits> la;
+};
+
+int encode_shift(int state) {
+  return LRTable::Action { LRTable::Kind::Shift, state }.encode();
+}
+
+int encode_reduce(int prod) {
+  return LRTable::Action { LRTable::Kind::Reduce, prod }.encode();
+}
+
+bool defaults_reduce(int value) {
+  return LRTable::Action::decode(value).kind == LRTable::Kind::Reduce;
+}
+
+bool defaults_any(int) {
+  return true;
+}
+
+/// Computes nullable variables and FIRST of every production suffix
+void compute_first(Grammar& g) {
+  vector<bool> nullable(g.num_vars, false);
+  vector<Bits> first(g.num_vars, Bits(g.num_terms));
+  bool changed;
+  do {
+    changed = false;
+    for (size_t p = 0; p < g.lhs.size(); p++) {
+      auto& A = g.lhs[p];
+      bool all_nullable = true;
+      for (auto sym: g.rhs[p]) {
+        if (!is_var(sym)) {
+          if (!first[A].test(sym)) { first[A].set(sym); changed = true; }
+          all_nullable = false;
+          break;
+        }
+        changed |= first[A].merge(first[var_of(sym)]);
+        if (!nullable[var_of(sym)]) { all_nullable = false; break; }
+      }
+      if (all_nullable && !nullable[A]) { nullable[A] = true; changed = true; }
+    }
+  } while (changed);
+
+  for (size_t p = 0; p < g.lhs.size(); p++) {
+    auto& rhs = g.rhs[p];
+    vector<Bits> fs(rhs.size() + 1, Bits(g.num_terms));
+    vector<bool> ns(rhs.size() + 1, true);
+    for (int d = (int)rhs.size() - 1; d >= 0; d--) {
+      auto sym = rhs[d];
+      if (!is_var(sym)) {
+        fs[d].set(sym);
+        ns[d] = false;
+        continue;
+      }
+      fs[d] = first[var_of(sym)];
+      ns[d] = nullable[var_of(sym)] && ns[d + 1];
+      if (nullable[var_of(sym)]) fs[d].merge(fs[d + 1]);
+    }
+    g.first_suffix.push_back(move(fs));
+    g.nullable_suffix.push_back(move(ns));
+  }
+}
+
+void closure(const Grammar& g, State& state) {
+  for (auto k: state.kernel) {
+    Item item;
+    item.prod = k.first;
+    item.dot = k.second;
+    state.items.push_back(item);
+  }
+  vector<int> expanded(g.num_vars, -1);
+  for (size_t i = 0; i < state.items.size(); i++) {
+    auto& rhs = g.rhs[state.items[i].prod];
+    auto dot = state.items[i].dot;
+    if (dot >= (int)rhs.size() || !is_var(rhs[dot])) continue;
+    auto B = var_of(rhs[dot]);
+    if (expanded[B] < 0) {
+      expanded[B] = state.items.size();
+      for (auto p: g.by_lhs[B]) {
+        Item item;
+        item.prod = p;
+        item.dot = 0;
+        state.items.push_back(item);
+      }
+    }
+    state.items[i].expand_begin = expanded[B];
+    state.items[i].expand_end = expanded[B] + g.by_lhs[B].size();
+  }
+}
+
+/// Builds the LR(0) automaton, filling goto links of every item
+vector<State> build_lr0(const Grammar& g) {
+  vector<State> states;
+  map<vector<pair<int, int>>, int> kernel_ids;
+
+  State initial;
+  initial.kernel = { { 0, 0 } };
+  kernel_ids[initial.kernel] = 0;
+  states.push_back(initial);
+  closure(g, states[0]);
+
+  for (size_t s = 0; s < states.size(); s++) {
+    // group advanced items by the symbol after the dot, in first-seen order
+    vector<int> symbols;
+    map<int, vector<pair<int, int>>> kernels;
+    for (auto& item: states[s].items) {
+      auto& rhs = g.rhs[item.prod];
+      if (item.dot >= (int)rhs.size()) continue;
+      auto X = rhs[item.dot];
+      if (kernels.find(X) == end(kernels)) symbols.push_back(X);
+      kernels[X].push_back({ item.prod, item.dot + 1 });
+    }
+    for (auto X: symbols) {
+      auto kernel = kernels[X];
+      sort(RANGE(kernel));
+      kernel.erase(unique(RANGE(kernel)), end(kernel));
+      int target;
+      auto it = kernel_ids.find(kernel);
+      if (it != end(kernel_ids)) {
+        target = it->second;
+      } else {
+        target = states.size();
+        kernel_ids[kernel] = target;
+        State state;
+        state.kernel = kernel;
+        states.push_back(state);
+        closure(g, states.back());
+      }
+      auto& target_kernel = states[target].kernel;
+      for (auto& item: states[s].items) {
+        auto& rhs = g.rhs[item.prod];
+        if (item.dot >= (int)rhs.size() || rhs[item.dot] != X) continue;
+        auto slot = lower_bound(RANGE(target_kernel), make_pair(item.prod, item.dot + 1));
+        item.next = target;
+        item.next_slot = slot - begin(target_kernel);
+      }
+    }
+  }
+  return states;
+}
+
+/// Propagates LALR(1) lookaheads over the LR(0) automaton until a fixpoint
+void propagate_lookaheads(const Grammar& g, vector<State>& states) {
+  for (auto& state: states) {
+    state.la.assign(state.items.size(), Bits(g.num_terms));
+  }
+  // end marker after the augmented start
+  states[0].la[0].set(0);
+
+  bool changed;
+  do {
+    changed = false;
+    for (auto& state: states) {
+      for (size_t i = 0; i < state.items.size(); i++) {
+        auto& item = state.items[i];
+        auto& rhs = g.rhs[item.prod];
+        if (item.dot >= (int)rhs.size()) continue;
+        if (is_var(rhs[item.dot])) {
+          auto& first = g.first_suffix[item.prod][item.dot + 1];
+          auto nullable = g.nullable_suffix[item.prod][item.dot + 1];
+          for (int j = item.expand_begin; j < item.expand_end; j++) {
+            changed |= state.la[j].merge(first);
+            if (nullable) changed |= state.la[j].merge(state.la[i]);
+          }
+        }
+        changed |= states[item.next].la[item.next_slot].merge(state.la[i]);
+      }
+    }
+  } while (changed);
+}
+
+}
+
+LRTable::Action LRTable::Action::decode(int value) {
+  switch (value & 3) {
+  case 1: return Action { Kind::Shift, value >> 2 };
+  case 2: return Action { Kind::Reduce, value >> 2 };
+  case 3: return Action { Kind::Accept, 0 };
+  default: return Action { Kind::Error, 0 };
+  }
+}
+
+int LRTable::Action::encode() const {
+  switch (kind) {
+  case Kind::Shift: return (value << 2) | 1;
+  case Kind::Reduce: return (value << 2) | 2;
+  case Kind::Accept: return 3;
+  default: return 0;
+  }
+}
+
+PackedTable PackedTable::pack(const vector<vector<int>>& rows, int error,
+                              bool (*can_default)(int)) {
+  PackedTable table;
+  table.base.assign(rows.size(), 0);
+  table.defaults.assign(rows.size(), error);
+
+  vector<vector<pair<int, int>>> entries(rows.size());
+  for (size_t r = 0; r < rows.size(); r++) {
+    // the most frequent defaultable value becomes the row default
+    unordered_map<int, int> counts;
+    for (auto v: rows[r]) {
+      if (v != error && can_default(v)) counts[v]++;
+    }
+    int best = 0;
+    for (auto kv: counts) {
+      if (kv.second > best || (kv.second == best && kv.first < table.defaults[r])) {
+        best = kv.second;
+        table.defaults[r] = kv.first;
+      }
+    }
+    for (size_t c = 0; c < rows[r].size(); c++) {
+      auto v = rows[r][c];
+      if (v != error && v != table.defaults[r]) entries[r].push_back({ c, v });
+    }
+  }
+
+  // first-fit, densest rows first
+  vector<int> order(rows.size());
+  for (size_t r = 0; r < order.size(); r++) order[r] = r;
+  stable_sort(RANGE(order), [&](int a, int b) {
+      return entries[a].size() > entries[b].size();
+    });
+  for (auto r: order) {
+    if (entries[r].empty()) continue;
+    int base = 0;
+    for (;; base++) {
+      auto fits = all_of(RANGE(entries[r]), [&](const pair<int, int>& e) {
+          auto i = base + e.first;
+          return i >= (int)table.check.size() || table.check[i] < 0;
+        });
+      if (fits) break;
+    }
+    table.base[r] = base;
+    for (auto e: entries[r]) {
+      size_t i = base + e.first;
+      if (i >= table.check.size()) {
+        table.check.resize(i + 1, -1);
+        table.next.resize(i + 1, error);
+      }
+      table.check[i] = r;
+      table.next[i] = e.second;
+    }
+  }
+  return table;
+}
+
+LRTable LRTable::build(const CFG& cfg) {
+  LRTable table;
+  Grammar g;
+
+  unordered_map<Var, int> var_index;
+  auto index_var = [&](const Var& var) {
+    auto it = var_index.find(var);
+    if (it != end(var_index)) return it->second;
+    var_index[var] = g.num_vars;
+    return g.num_vars++;
+  };
+  table.term_index.assign(256, -1);
+  table.terms.push_back('$');
+  auto index_term = [&](const Term& term) {
+    auto& index = table.term_index[(unsigned char)term.value];
+    if (index < 0) {
+      index = table.terms.size();
+      table.terms.push_back(term.value);
+    }
+    return index;
+  };
+
+  // the augmented start symbol, primed until no variable has its name
+  std::string start = "S'";
+  while (SymbolTable::global().contains(start)) start += "'";
+  table.prods.push_back(Prod { Var(start), { cfg.start } });
+  for (auto prod: cfg.prods) {
+    table.prods.push_back(prod.to_prod());
+  }
+  for (auto& prod: table.prods) {
+    g.lhs.push_back(index_var(prod.lhs));
+    vector<int> rhs;
+    for (auto& sym: prod.rhs) {
+      rhs.push_back(sym.is_var() ? ~index_var(sym.as_var()) : index_term(sym.as_term()));
+    }
+    g.rhs.push_back(rhs);
+    table.prod_lhs.push_back(g.lhs.back());
+    table.prod_len.push_back(rhs.size());
+  }
+  g.num_terms = table.terms.size();
+  g.by_lhs.resize(g.num_vars);
+  for (size_t p = 0; p < g.lhs.size(); p++) {
+    g.by_lhs[g.lhs[p]].push_back(p);
+  }
+  compute_first(g);
+
+  auto states = build_lr0(g);
+  propagate_lookaheads(g, states);
+  table.num_states = states.size();
+
+  vector<vector<int>> action_rows(states.size(), vector<int>(g.num_terms, 0));
+  vector<vector<int>> goto_rows(g.num_vars, vector<int>(states.size(), -1));
+  for (size_t s = 0; s < states.size(); s++) {
+    auto& row = action_rows[s];
+    for (auto& item: states[s].items) {
+      auto& rhs = g.rhs[item.prod];
+      if (item.dot >= (int)rhs.size()) continue;
+      auto X = rhs[item.dot];
+      if (is_var(X)) goto_rows[var_of(X)][s] = item.next;
+      else row[X] = encode_shift(item.next);
+    }
+    for (size_t i = 0; i < states[s].items.size(); i++) {
+      auto& item = states[s].items[i];
+      if (item.dot < (int)g.rhs[item.prod].size()) continue;
+      auto reduce = item.prod == 0 ? Action { Kind::Accept, 0 }.encode() : encode_reduce(item.prod);
+      for (int t = 0; t < g.num_terms; t++) {
+        if (!states[s].la[i].test(t) || row[t] == reduce) continue;
+        if (row[t] == 0) { row[t] = reduce; continue; }
+        // shift wins over reduce, and the earlier production wins over later ones
+        auto existing = Action::decode(row[t]);
+        auto incoming = Action::decode(reduce);
+        auto keep = existing.kind == Kind::Shift || existing.kind == Kind::Accept
+          || (existing.kind == Kind::Reduce && existing.value < item.prod);
+        if (keep) {
+          table.conflicts.push_back(Conflict { (int)s, t, existing, incoming });
+        } else {
+          table.conflicts.push_back(Conflict { (int)s, t, incoming, existing });
+          row[t] = reduce;
+        }
+      }
+    }
+  }
+
+  table.actions = PackedTable::pack(action_rows, 0, defaults_reduce);
+  table.gotos = PackedTable::pack(goto_rows, -1, defaults_any);
+  return table;
+}
+
+bool LRTable::parse(const string& input) const {
+  LRStream stream(*this);
+  for (auto c: input) {
+    if (!stream.push(c)) return false;
+  }
+  return stream.finish();
+}
+
+bool LRStream::push(char c) {
+  if (failed) return false;
+  auto term = table.term_index[(unsigned char)c];
+  if (term < 0) {
+    failed = true;
+    return false;
+  }
+  for (;;) {
+    auto a = table.action(stack.back(), term);
+    switch (a.kind) {
+    case LRTable::Kind::Shift:
+      stack.push_back(a.value);
+      consumed++;
+      return true;
+    case LRTable::Kind::Reduce:
+      assert(stack.size() > (size_t)table.prod_len[a.value]);
+      stack.resize(stack.size() - table.prod_len[a.value]);
+      stack.push_back(table.go(stack.back(), table.prod_lhs[a.value]));
+      break;
+    default:
+      // accept only happens on the end marker
+      failed = true;
+      return false;
+    }
+  }
+}
+
+bool LRStream::finish() {
+  if (failed) return false;
+  for (;;) {
+    auto a = table.action(stack.back(), 0);
+    switch (a.kind) {
+    case LRTable::Kind::Reduce:
+      stack.resize(stack.size() - table.prod_len[a.value]);
+      stack.push_back(table.go(stack.back(), table.prod_lhs[a.value]));
+      break;
+    case LRTable::Kind::Accept:
+      return true;
+    default:
+      failed = true;
+      return false;
+    }
+  }
+}
+
+static void print_action(ostream& os, const LRTable& table, const LRTable::Action& a) {
+  switch (a.kind) {
+  case LRTable::Kind::Shift: os << "shift " << a.value; break;
+  case LRTable::Kind::Reduce: os << "reduce " << table.prods[a.value]; break;
+  case LRTable::Kind::Accept: os << "accept"; break;
+  case LRTable::Kind::Error: os << "error"; break;
+  }
+}
+
+void LRTable::print_conflict(ostream& os, const Conflict& conflict) const {
+  auto rr = conflict.chosen.kind != Kind::Shift && conflict.rejected.kind != Kind::Shift;
+  os << "state " << conflict.state << ": "
+     << (rr ? "reduce/reduce" : "shift/reduce") << " conflict on ";
+  if (conflict.term == 0) os << "end of input";
+  else os << "'" << terms[conflict.term] << "'";
+  os << ", ";
+  print_action(os, *this, conflict.chosen);
+  os << " over ";
+  print_action(os, *this, conflict.rejected);
+}
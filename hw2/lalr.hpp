@@ -0,0 +1,92 @@
+#include "cfg.hpp"
+
+#ifndef _LALR_
+#define _LALR_
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+/// Row-displacement packed 2D table with a default value per row.
+/// Lookup is base[row] + col, validated by check.
+struct PackedTable {
+  std::vector<int> base;
+  std::vector<int> check;
+  std::vector<int> next;
+  std::vector<int> defaults;
+
+  int get(int row, int col) const {
+    auto i = base[row] + col;
+    if (i < (int)check.size() && check[i] == row) return next[i];
+    return defaults[row];
+  }
+
+  /// `can_default` decides which values may be elided into a row default.
+  static PackedTable pack(const std::vector<std::vector<int>>& rows, int error,
+                          bool (*can_default)(int));
+};
+
+struct LRTable {
+  enum class Kind { Error, Shift, Reduce, Accept };
+
+  struct Action {
+    Kind kind;
+    int value;
+
+    static Action decode(int);
+    int encode() const;
+  };
+
+  struct Conflict {
+    int state;
+    int term;
+    Action chosen;
+    Action rejected;
+  };
+
+  /// prods[0] is the augmented production <S'>:<start>
+  std::vector<Prod> prods;
+  std::vector<int> prod_lhs;
+  std::vector<int> prod_len;
+  /// input character to terminal column, -1 if not in the grammar.
+  /// column 0 is the end marker.
+  std::vector<int> term_index;
+  std::vector<char> terms;
+  int num_states = 0;
+  PackedTable actions;
+  PackedTable gotos;
+  std::vector<Conflict> conflicts;
+
+  static LRTable build(const CFG&);
+
+  Action action(int state, int term) const {
+    return Action::decode(actions.get(state, term));
+  }
+  int go(int state, int var) const {
+    return gotos.get(var, state);
+  }
+
+  bool parse(const std::string&) const;
+  void print_conflict(std::ostream&, const Conflict&) const;
+};
+
+/// Push interface to an LRTable. Characters are fed one at a time and only
+/// the parse stack is kept, so memory follows the nesting depth of the
+/// input rather than its length. An LR parser detects an error on the first
+/// character that cannot continue any sentence.
+struct LRStream {
+  const LRTable& table;
+  std::vector<int> stack { 0 };
+  size_t consumed = 0;
+  bool failed = false;
+
+  explicit LRStream(const LRTable& table): table(table) {}
+
+  /// false once the input so far is not a prefix of any sentence
+  bool push(char);
+  /// ends the input; whether it is a sentence
+  bool finish();
+  bool viable() const { return !failed; }
+};
+
+#endif
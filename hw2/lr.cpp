@@ -0,0 +1,21 @@
+#include "cfg.hpp"
+#include "lalr.hpp"
+#include <iostream>
+
+using namespace std;
+
+int main() {
+  const CFG cfg = CFG::read(cin);
+  string str;
+  cin >> str;
+  auto table = LRTable::build(cfg);
+  if (!table.conflicts.empty()) {
+    for (auto& conflict: table.conflicts) {
+      table.print_conflict(cerr, conflict);
+      cerr << endl;
+    }
+    cerr << "grammar is not LALR(1)" << endl;
+    return 1;
+  }
+  cout << (table.parse(str) ? "Yes" : "No");
+}
@@ -0,0 +1,50 @@
+#include "cfg.hpp"
+#include "to_cnf.hpp"
+#include "weighted_cnf.hpp"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+/// usage: pcyk [+] [-i] [-t]
+/// Scores every whitespace separated word after a weighted grammar. Prints
+/// No, or Yes and the log-probability of the best derivation; with -i of
+/// all derivations. -t also prints the best derivation. -i cannot be
+/// combined with +, whose conversion keeps only the best derivations.
+int main(int argc, char *argv[]) {
+  bool convert = false, inside = false, tree = false;
+  for (int i=1; i<argc; i++) {
+    if (strcmp(argv[i], "+") == 0) convert = true;
+    else if (strcmp(argv[i], "-i") == 0) inside = true;
+    else if (strcmp(argv[i], "-t") == 0) tree = true;
+  }
+  if (convert && inside) {
+    std::cerr << "-i cannot be combined with +" << std::endl;
+    return 1;
+  }
+
+  auto input = read_all(std::cin);
+  const char* cur = input.data();
+  const char* end = cur + input.size();
+  const CFG cfg = CFG::parse(cur, end);
+  auto inputs = read_words(cur, end);
+
+  const CFG cnf = convert ? to_cnf(cfg) : cfg;
+  const WeightedCNF grammar(cnf);
+  ScoreChart chart;
+  for (size_t i=0; i<inputs.size(); i++) {
+    if (i > 0) std::cout << "\n";
+    auto score = grammar.score(inputs[i], inside ? Semiring::Inside : Semiring::Viterbi, chart);
+    if (std::isinf(score) && score < 0) {
+      std::cout << "No";
+      continue;
+    }
+    std::cout << "Yes " << score;
+    if (tree) {
+      if (inside) grammar.score(inputs[i], Semiring::Viterbi, chart);
+      std::cout << " ";
+      print_parse(std::cout, grammar.best_parse(inputs[i], chart));
+    }
+  }
+}
@@ -0,0 +1,168 @@
+#include "simplify.hpp"
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <map>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+using Var = Symbol::Var;
+#define RANGE(x) begin(x), end(x)
+
+/// Marks A once some A -> x has every rhs variable marked. Every production
+/// counts its rhs variables not yet marked; occurrences are kept as a CSR
+/// index so that marking B only visits the productions using B.
+/// Unless `allow_terms`, productions containing a terminal never count.
+static vector<bool> counter_closure(const CFG& G, bool allow_terms) {
+  auto n = G.var_id_bound();
+  vector<bool> marked(n, false);
+  vector<uint32_t> pending(G.prods.size(), 0);
+  vector<uint32_t> occurs_begin(n + 1, 0);
+  vector<bool> blocked(G.prods.size(), false);
+  for(size_t p=0; p<G.prods.size(); p++) {
+    auto prod = G.prods[p];
+    blocked[p] = !allow_terms && any_of(RANGE(prod.rhs), [](Symbol sym) {
+        return sym.is_term();
+      });
+    if (blocked[p]) continue;
+    for(auto sym: prod.rhs) {
+      if (sym.is_var()) occurs_begin[sym.as_var().id + 1]++;
+    }
+  }
+  for(size_t i=0; i<n; i++) {
+    occurs_begin[i + 1] += occurs_begin[i];
+  }
+  vector<uint32_t> occurs(occurs_begin[n]);
+  auto cursor = occurs_begin;
+
+  vector<Var> worklist;
+  for(size_t p=0; p<G.prods.size(); p++) {
+    if (blocked[p]) continue;
+    auto prod = G.prods[p];
+    for(auto sym: prod.rhs) {
+      if (sym.is_term()) continue;
+      occurs[cursor[sym.as_var().id]++] = p;
+      pending[p]++;
+    }
+    if (pending[p] == 0 && !marked[prod.lhs.id]) {
+      marked[prod.lhs.id] = true;
+      worklist.push_back(prod.lhs);
+    }
+  }
+  while(!worklist.empty()) {
+    auto B = worklist.back();
+    worklist.pop_back();
+    for(auto o=occurs_begin[B.id]; o<occurs_begin[B.id + 1]; o++) {
+      auto p = occurs[o];
+      if (--pending[p] > 0) continue;
+      auto A = G.prods[p].lhs;
+      if (marked[A.id]) continue;
+      marked[A.id] = true;
+      worklist.push_back(A);
+    }
+  }
+  return marked;
+}
+
+vector<bool> get_nullable(const CFG& G) {
+  return counter_closure(G, false);
+}
+
+vector<bool> get_generating(const CFG& G) {
+  return counter_closure(G, true);
+}
+
+CFG remove_useless(const CFG& G) {
+  // 1. Keep productions whose every variable generates a terminal string
+  auto generating = get_generating(G);
+  ProdArena useful;
+  for(auto prod: G.prods) {
+    auto keep = generating[prod.lhs.id]
+      && all_of(RANGE(prod.rhs), [&](Symbol sym) {
+          return sym.is_term() || generating[sym.as_var().id];
+        });
+    if (keep) useful.push_back(prod);
+  }
+  useful.normalize();
+  auto ranges = useful.lhs_ranges();
+  // the start symbol may have lost every production
+  ranges.resize(G.var_id_bound(), { 0, 0 });
+
+  // 2. Keep productions reachable from the start symbol through them
+  vector<bool> reachable(G.var_id_bound(), false);
+  vector<Var> worklist { G.start };
+  reachable[G.start.id] = true;
+  ProdArena P;
+  while(!worklist.empty()) {
+    auto A = worklist.back();
+    worklist.pop_back();
+    for(auto p=ranges[A.id].first; p<ranges[A.id].second; p++) {
+      auto prod = useful[p];
+      P.push_back(prod);
+      for(auto sym: prod.rhs) {
+        if (sym.is_term() || reachable[sym.as_var().id]) continue;
+        reachable[sym.as_var().id] = true;
+        worklist.push_back(sym.as_var());
+      }
+    }
+  }
+  return G.with_prods(move(P));
+}
+
+CFG merge_equivalent(const CFG& G) {
+  auto prods = G.prods;
+  prods.normalize();
+
+  for(;;) {
+    // signature of a variable: its normalized productions, flattened
+    map<Var, vector<uint32_t>> signatures;
+    for(auto prod: prods) {
+      auto& sig = signatures[prod.lhs];
+      sig.push_back(prod.rhs.size());
+      for(auto sym: prod.rhs) sig.push_back(sym.value);
+      uint32_t weight;
+      memcpy(&weight, &prod.weight, sizeof weight);
+      sig.push_back(weight);
+    }
+    // start symbol first, then by name, so the representative is stable
+    vector<Var> vars;
+    for(auto& kv: signatures) {
+      if (kv.first != G.start) vars.push_back(kv.first);
+    }
+    if (signatures.find(G.start) != end(signatures)) {
+      vars.insert(begin(vars), G.start);
+    }
+
+    map<vector<uint32_t>, Var> owners;
+    vector<uint32_t> rep(G.var_id_bound());
+    for(size_t i=0; i<rep.size(); i++) rep[i] = i;
+    bool merged = false;
+    for(auto var: vars) {
+      auto it = owners.insert({ signatures[var], var });
+      if (it.second) continue;
+      rep[var.id] = it.first->second.id;
+      merged = true;
+    }
+    if (!merged) break;
+
+    ProdArena next;
+    next.reserve(prods.size(), prods.size() * 2);
+    Prod::Rhs rhs;
+    for(auto prod: prods) {
+      if (rep[prod.lhs.id] != prod.lhs.id) continue;
+      rhs.clear();
+      for(auto sym: prod.rhs) {
+        rhs.push_back(sym.is_var() ? Symbol(Var::from_id(rep[sym.as_var().id])) : sym);
+      }
+      next.push_back(prod.lhs, rhs.data(), rhs.size(), prod.weight);
+    }
+    next.normalize();
+    prods = move(next);
+  }
+  return G.with_prods(move(prods));
+}
+
+CFG simplify(const CFG& cfg) {
+  return remove_useless(merge_equivalent(remove_useless(cfg)));
+}
@@ -0,0 +1,25 @@
+#include "cfg.hpp"
+
+#ifndef _SIMPLIFY_
+#define _SIMPLIFY_
+
+#include <vector>
+
+/// Variables deriving the empty string, indexed by interned id
+std::vector<bool> get_nullable(const CFG& cfg);
+
+/// Variables deriving some terminal string, indexed by interned id
+std::vector<bool> get_generating(const CFG& cfg);
+
+/// Drops productions using non-generating variables, then productions of
+/// variables unreachable from the start symbol.
+CFG remove_useless(const CFG& cfg);
+
+/// Merges variables having exactly the same set of weighted productions, until no
+/// two variables do. The start symbol and otherwise the smallest name
+/// survive a merge.
+CFG merge_equivalent(const CFG& cfg);
+
+CFG simplify(const CFG& cfg);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _SMALL_VECTOR_H_
+#define _SMALL_VECTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <initializer_list>
+#include <type_traits>
+
+/// Vector of trivially copyable values keeping up to N of them inline.
+/// Grows onto the heap only past N elements.
+template<typename T, size_t N>
+class SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SmallVector only holds trivially copyable values");
+
+  uint32_t size_ = 0;
+  uint32_t capacity_ = N;
+  T* heap_ = nullptr;
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type inline_;
+
+  T* storage() { return heap_ ? heap_ : reinterpret_cast<T*>(&inline_); }
+  const T* storage() const { return heap_ ? heap_ : reinterpret_cast<const T*>(&inline_); }
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() {}
+  SmallVector(std::initializer_list<T> init) { assign(init.begin(), init.end()); }
+  template<typename It>
+  SmallVector(It first, It last) { assign(first, last); }
+  SmallVector(const SmallVector& other) { assign(other.begin(), other.end()); }
+  SmallVector(SmallVector&& other) noexcept { *this = std::move(other); }
+  ~SmallVector() { ::operator delete(heap_); }
+
+  SmallVector& operator=(const SmallVector& other) {
+    if (this != &other) assign(other.begin(), other.end());
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& other) noexcept {
+    if (this == &other) return *this;
+    ::operator delete(heap_);
+    heap_ = nullptr;
+    capacity_ = N;
+    size_ = other.size_;
+    if (other.heap_) {
+      heap_ = other.heap_;
+      capacity_ = other.capacity_;
+      other.heap_ = nullptr;
+      other.capacity_ = N;
+    } else {
+      std::memcpy(storage(), other.storage(), size_ * sizeof(T));
+    }
+    other.size_ = 0;
+    return *this;
+  }
+
+  template<typename It>
+  void assign(It first, It last) {
+    clear();
+    for (; first != last; ++first) push_back(*first);
+  }
+
+  void reserve(size_t capacity) {
+    if (capacity <= capacity_) return;
+    auto grown = static_cast<T*>(::operator new(capacity * sizeof(T)));
+    std::memcpy(grown, storage(), size_ * sizeof(T));
+    ::operator delete(heap_);
+    heap_ = grown;
+    capacity_ = capacity;
+  }
+
+  void push_back(const T& value) {
+    if (size_ == capacity_) {
+      auto copy = value;
+      reserve(capacity_ * 2);
+      new (storage() + size_++) T(copy);
+      return;
+    }
+    new (storage() + size_++) T(value);
+  }
+
+  void pop_back() { size_--; }
+  void clear() { size_ = 0; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T* data() { return storage(); }
+  const T* data() const { return storage(); }
+  T& operator[](size_t i) { return storage()[i]; }
+  const T& operator[](size_t i) const { return storage()[i]; }
+  T& back() { return storage()[size_ - 1]; }
+  const T& back() const { return storage()[size_ - 1]; }
+
+  iterator begin() { return storage(); }
+  iterator end() { return storage() + size_; }
+  const_iterator begin() const { return storage(); }
+  const_iterator end() const { return storage() + size_; }
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "cfg.hpp"
+#include "lalr.hpp"
+#include <iostream>
+#include <cstring>
+#include <cctype>
+
+using namespace std;
+
+/// usage: stream [-v]
+/// Reads a grammar, then recognizes the rest of the input as one string,
+/// whitespace ignored, as it arrives; nothing but the parse stack is kept.
+/// Prints Yes/No, stopping at the first character that cannot continue a
+/// sentence. -v reports that position and the deepest stack on stderr.
+int main(int argc, char *argv[]) {
+  bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+  const CFG cfg = CFG::read(cin);
+  auto table = LRTable::build(cfg);
+  if (!table.conflicts.empty()) {
+    for (auto& conflict: table.conflicts) {
+      table.print_conflict(cerr, conflict);
+      cerr << "\n";
+    }
+    cerr << "grammar is not LALR(1)" << endl;
+    return 1;
+  }
+
+  LRStream stream(table);
+  size_t deepest = 0;
+  auto buf = cin.rdbuf();
+  for (int c = buf->sbumpc(); c != EOF; c = buf->sbumpc()) {
+    if (isspace(c)) continue;
+    if (!stream.push(c)) break;
+    deepest = max(deepest, stream.stack.size());
+  }
+  auto accepted = stream.viable() && stream.finish();
+  if (verbose) {
+    if (!stream.viable()) cerr << "rejected after " << stream.consumed << " characters\n";
+    cerr << "deepest stack " << deepest << "\n";
+  }
+  cout << (accepted ? "Yes" : "No");
+}
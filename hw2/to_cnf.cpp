@@ -1,11 +1,14 @@
 #include "to_cnf.hpp"
+#include "simplify.hpp"
 #include "cfg.hpp"
 
-#include <unordered_set>
 #include <unordered_map>
 #include <algorithm>
-#include <queue>
 #include <cassert>
+#include <cstdint>
+#include <cmath>
+#include <queue>
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
 
@@ -14,228 +17,331 @@ using Var = Symbol::Var;
 using Term = Symbol::Term;
 #define RANGE(x) begin(x), end(x)
 
-/// Implements 1.1
-static unordered_set<Var> get_Ve(const CFG& cfg) {
-  unordered_set<Var> Ve;
-  bool changed;
-  do {
-    changed = false;
-    for(auto prod: cfg.prods) {
-      // If all variable in the rhs is an epsilon production (a member of Ve),
-      auto epsilon_prod = all_of(RANGE(prod.rhs), [&](auto sym) {
-          if (sym.is_var() == false) return false;
-          return Ve.find(sym.as_var()) != end(Ve);
-        });
-      // then insert it to Ve
-      if (epsilon_prod) {
-        auto result = Ve.insert(prod.lhs);
-        if (result.second) {
-          changed = true;
-        }
+/// Implements 1
+/// Splits every rhs longer than two into a right-branching chain
+/// A -> X1 C1, C1 -> X2 C2, ..., Cn -> Xk-1 Xk, so that epsilon removal
+/// below only has at most 4 variants per rule. A chain variable stands for
+/// an rhs suffix and is shared by every production ending with it.
+static CFG binarize(const CFG& G) {
+  CFG G1 { G.start, {} };
+  G1.next_ids = G.next_ids;
+  G1.prods.reserve(G.prods.size() * 2, G.prods.size() * 4);
+  unordered_map<uint64_t, Var> suffixes;
+  for(auto prod: G.prods) {
+    if (prod.rhs.size() <= 2) {
+      G1.prods.push_back(prod);
+      continue;
+    }
+    Symbol tail = prod.rhs[prod.rhs.size() - 1];
+    for(size_t i=prod.rhs.size() - 2; i >= 1; i--) {
+      auto key = (uint64_t)prod.rhs[i].value << 32 | tail.value;
+      auto it = suffixes.find(key);
+      if (it == end(suffixes)) {
+        auto var = G1.new_id();
+        it = suffixes.emplace(key, var).first;
+        G1.prods.push_back(var, { prod.rhs[i], tail });
       }
+      tail = it->second;
     }
-  } while (changed);
-  return Ve;
-}
-
-static vector<bool> init_combination(const unordered_set<Var>& Ve, const vector<Symbol>& rhs) {
-  auto size = count_if(RANGE(rhs), [&](auto sym) {
-      if (sym.is_term()) return false;
-      return Ve.find(sym.as_var()) != end(Ve);
-    });
-  vector<bool> arr;
-  for(decltype(size) i=0; i<size; i++)
-    arr.push_back(true);
-  return arr;
-}
-
-static bool next_combination(vector<bool> &comb) {
-  for (size_t i=0; i<comb.size(); i++) {
-    if (comb[i]) { comb[i] = false; return true; }
-    else { comb[i] = true; }
+    G1.prods.push_back(prod.lhs, { prod.rhs[0], tail }, prod.weight);
   }
-  return false;
+  return G1;
 }
 
-struct epsilon_combinator {
-  const unordered_set<Var>& Ve;
-  const vector<bool>& comb;
-  epsilon_combinator(const unordered_set<Var>& Ve,
-                      const vector<bool>& comb)
-    : Ve(Ve), comb(comb) {}
-
-  vector<Symbol> get(const vector<Symbol>& rhs) {
-    vector<bool> current_combination = comb;
-    vector<Symbol> new_rhs;
-    for (auto sym: rhs) {
-      if (sym.is_term()) { new_rhs.push_back(sym); continue; }
-      auto Ve_member = Ve.find(sym.as_var()) != end(Ve);
-      if (!Ve_member){ new_rhs.push_back(sym); continue; }
-      if (current_combination.back()) {
-        new_rhs.push_back(sym);
+/// Best log-probability of deriving the empty string from each nullable
+/// variable. With weights <= 0 the best derivation never repeats a
+/// variable along a path, so one round per variable suffices.
+static vector<float> epsilon_weights(const CFG& G, const vector<bool>& nullable) {
+  vector<float> best(G.var_id_bound(), 0);
+  if (!G.prods.weighted()) return best;
+  fill(RANGE(best), -INFINITY);
+  auto rounds = count(RANGE(nullable), true) + 1;
+  for(bool changed = true; changed && rounds-- > 0;) {
+    changed = false;
+    for(auto prod: G.prods) {
+      float weight = prod.weight;
+      for(auto sym: prod.rhs) {
+        weight += sym.is_var() && nullable[sym.as_var().id] ? best[sym.as_var().id] : -INFINITY;
+      }
+      if (weight > best[prod.lhs.id]) {
+        best[prod.lhs.id] = weight;
+        changed = true;
       }
-      current_combination.pop_back();
     }
-    return new_rhs;
   }
-};
+  return best;
+}
 
-/// Implements 1
+/// Implements 2
+/// A dropped nullable variable adds its best epsilon derivation's weight.
 static CFG remove_epsilon(const CFG& G) {
-  // 1.1
-  auto Ve = get_Ve(G);
+  // 2.1
+  auto nullable = get_nullable(G);
+  auto epsilon = epsilon_weights(G, nullable);
 
-  unordered_set<Prod> P1_set;
-  // 1.2 for each production rule in P,
-  // insert every combination of an epsilon replaced rule
+  // 2.2 for each production rule in P, insert every combination of
+  // an epsilon replaced rule. Rules are binary, so there are at most 4.
+  ProdArena P2;
+  P2.reserve(G.prods.size() * 2, G.prods.size() * 4);
   for(auto prod: G.prods) {
-    auto combination = init_combination(Ve, prod.rhs);
-    do {
-      auto rhs = epsilon_combinator(Ve, combination).get(prod.rhs);
-      if (rhs.size() > 0) P1_set.insert(Prod { prod.lhs, rhs });
-    } while (next_combination(combination));
+    auto n = prod.rhs.size();
+    assert(n <= 2);
+    for(unsigned keep=0; keep < (1u << n); keep++) {
+      Symbol rhs[2] = { Term(0), Term(0) };
+      size_t length = 0;
+      bool valid = true;
+      float weight = prod.weight;
+      for(size_t i=0; i<n; i++) {
+        auto sym = prod.rhs[i];
+        if (keep & (1u << i)) { rhs[length++] = sym; continue; }
+        if (sym.is_term() || !nullable[sym.as_var().id]) { valid = false; break; }
+        weight += epsilon[sym.as_var().id];
+      }
+      if (valid && length > 0) P2.push_back(prod.lhs, rhs, length, weight);
+    }
   }
 
-  // 1.3 G1 is equivalent with G
-  auto G1 = CFG { G.start, {} };
-  copy(RANGE(P1_set), back_inserter(G1.prods));
-  sort(RANGE(G1.prods));
-  return G1;
+  // 2.3 G2 is equivalent with G
+  return G.with_prods(move(P2));
 }
 
-namespace std {
-template<>
-struct hash<pair<Var, Var>> {
-  size_t operator()(const pair<Var, Var>& x) const {
-    return hash<Var>()(x.first) * 31 + hash<Var>()(x.second);
+/// Strongly connected components of the unit graph, numbered in reverse
+/// topological order (every edge goes to a component with a lower or equal
+/// number). Iterative Tarjan; the edges of A are the unit productions in
+/// A's range of the normalized grammar.
+static vector<int> unit_components(const CFG& G, const vector<Var>& vars,
+                                   const vector<pair<uint32_t, uint32_t>>& ranges,
+                                   int& num_components) {
+  vector<int> component(G.var_id_bound(), -1);
+  vector<int> order(G.var_id_bound(), -1);
+  vector<int> low(G.var_id_bound(), 0);
+  vector<bool> on_stack(G.var_id_bound(), false);
+  vector<Var> stack;
+  vector<pair<Var, uint32_t>> frames;
+  int counter = 0;
+  num_components = 0;
+
+  for(auto root: vars) {
+    if (order[root.id] >= 0) continue;
+    frames.push_back({ root, ranges[root.id].first });
+    order[root.id] = low[root.id] = counter++;
+    stack.push_back(root);
+    on_stack[root.id] = true;
+    while(!frames.empty()) {
+      auto v = frames.back().first;
+      auto& next_edge = frames.back().second;
+      if (next_edge < ranges[v.id].second) {
+        auto prod = G.prods[next_edge++];
+        if (!prod.is_unit()) continue;
+        auto w = prod.rhs[0].as_var();
+        if (order[w.id] < 0) {
+          order[w.id] = low[w.id] = counter++;
+          stack.push_back(w);
+          on_stack[w.id] = true;
+          frames.push_back({ w, ranges[w.id].first });
+        } else if (on_stack[w.id]) {
+          low[v.id] = min(low[v.id], order[w.id]);
+        }
+        continue;
+      }
+      frames.pop_back();
+      if (!frames.empty()) {
+        auto parent = frames.back().first;
+        low[parent.id] = min(low[parent.id], low[v.id]);
+      }
+      if (low[v.id] != order[v.id]) continue;
+      Var w = v;
+      do {
+        w = stack.back();
+        stack.pop_back();
+        on_stack[w.id] = false;
+        component[w.id] = num_components;
+      } while(w != v);
+      num_components++;
+    }
   }
-};
+  return component;
 }
 
-static vector<pair<Var, Var>>
-get_unit_paths(const unordered_multimap<Var, vector<Symbol>>& prods) {
-  unordered_set<Var> vars;
-  for(auto kv: prods) {
-    vars.insert(kv.first);
-  }
-  // DFS traversal to find unit derivatives from every variable
-  unordered_set<pair<Var, Var>> unit_paths;
-  for(auto var: vars) {
-    unordered_set<Var> visited;
-    queue<Var> queue;
-    queue.push(var);
+/// Implements 3 for weighted grammars: A -> x gets the weight of the best
+/// unit path A =>* B plus that of B -> x. Paths are found with Dijkstra
+/// from every variable, which is exact for log-probabilities (<= 0).
+static CFG remove_weighted_unit_paths(const CFG& G2) {
+  auto ranges = G2.prods.lhs_ranges();
+  vector<float> best(G2.var_id_bound(), -INFINITY);
+  vector<bool> done(G2.var_id_bound(), false);
+  vector<Var> reached;
+  priority_queue<pair<float, uint32_t>> queue;
+  ProdArena P3;
+  for(size_t p=0; p<G2.prods.size(); p++) {
+    auto A = G2.prods[p].lhs;
+    if (ranges[A.id].first != p) continue;
+    best[A.id] = 0;
+    queue.push({ 0.0f, A.id });
     while(!queue.empty()) {
-      Var popped = queue.front();
+      auto B = Var::from_id(queue.top().second);
       queue.pop();
-      visited.insert(popped);
-      auto adjs = prods.equal_range(popped);
-      for_each(adjs.first, adjs.second, [&](auto pair) {
-          auto prod = Prod { pair.first, pair.second };
-          if (!prod.is_unit()) return;
-          auto rhs = prod.rhs[0].as_var();
-          if (visited.find(rhs) != std::end(visited)) return;
-          queue.push(rhs);
-          unit_paths.insert({var, rhs});
-        });
+      if (done[B.id]) continue;
+      done[B.id] = true;
+      reached.push_back(B);
+      for(auto q=ranges[B.id].first; q<ranges[B.id].second; q++) {
+        auto prod = G2.prods[q];
+        if (!prod.is_unit()) {
+          P3.push_back(A, prod.rhs, best[B.id] + prod.weight);
+          continue;
+        }
+        auto C = prod.rhs[0].as_var();
+        auto weight = best[B.id] + prod.weight;
+        if (!done[C.id] && weight > best[C.id]) {
+          best[C.id] = weight;
+          queue.push({ weight, C.id });
+        }
+      }
     }
+    for(auto B: reached) {
+      best[B.id] = -INFINITY;
+      done[B.id] = false;
+    }
+    reached.clear();
   }
-
-  vector<pair<Var, Var>> result;
-  copy(RANGE(unit_paths), back_inserter(result));
-  sort(RANGE(result));
-  return result;
+  return G2.with_prods(move(P3));
 }
 
-/// Implements 2
-static CFG remove_unit_paths(const CFG& G1) {
-  unordered_multimap<Var, vector<Symbol>> P1;
-  for(auto prod: G1.prods) {
-    P1.insert({prod.lhs, prod.rhs});
+/// Implements 3
+static CFG remove_unit_paths(const CFG& G2) {
+  if (G2.prods.weighted()) return remove_weighted_unit_paths(G2);
+  auto ranges = G2.prods.lhs_ranges();
+  vector<Var> vars;
+  for(size_t p=0; p<G2.prods.size(); p++) {
+    auto lhs = G2.prods[p].lhs;
+    if (ranges[lhs.id].first == p) vars.push_back(lhs);
   }
 
-  // 2.1 Get unit paths that satisfy A =>* B
-  auto unit_paths = get_unit_paths(P1);
+  // 3.1 Collapse unit cycles; variables in one component derive each other
+  int num_components;
+  auto component = unit_components(G2, vars, ranges, num_components);
+  vector<uint32_t> members_begin(num_components + 1, 0);
+  for(auto var: vars) {
+    members_begin[component[var.id] + 1]++;
+  }
+  for(int c=0; c<num_components; c++) {
+    members_begin[c + 1] += members_begin[c];
+  }
+  auto members = vars;
+  stable_sort(RANGE(members), [&](Var a, Var b) {
+      return component[a.id] < component[b.id];
+    });
 
-  // 2.2 Insert productions that are not an unit production.
-  unordered_set<Prod> P2_set;
-  for(auto prod: G1.prods) {
-    if (!prod.is_unit()) P2_set.insert(prod);
+  // 3.2 Unit closure over the condensation, sinks first:
+  // reach[c] holds every component d such that c =>* d
+  size_t words = (num_components + 63) / 64;
+  vector<uint64_t> reach(num_components * words, 0);
+  for(int c=0; c<num_components; c++) {
+    auto reach_c = &reach[c * words];
+    reach_c[c / 64] |= (uint64_t)1 << (c % 64);
+    for(auto m=members_begin[c]; m<members_begin[c + 1]; m++) {
+      auto A = members[m];
+      for(auto p=ranges[A.id].first; p<ranges[A.id].second; p++) {
+        auto prod = G2.prods[p];
+        if (!prod.is_unit()) continue;
+        auto d = component[prod.rhs[0].as_var().id];
+        if (d == c) continue;
+        assert(d < c);
+        auto reach_d = &reach[d * words];
+        for(size_t i=0; i<words; i++) reach_c[i] |= reach_d[i];
+      }
+    }
   }
 
-  // 2.3 If A =>* B, B -> x in P1, and B -> is not an unit,
-  // then insert A -> x to P2
-  for(auto unit_path: unit_paths) {
-    auto A = unit_path.first;
-    auto B_xs = P1.equal_range(unit_path.second);
-    for_each(B_xs.first, B_xs.second, [&](auto B_x) {
-        auto B = B_x.first;
-        auto x = B_x.second;
-        assert(unit_path.second == B);
-        auto reduced = Prod { A, x };
-        if (!reduced.is_unit()) P2_set.insert(reduced);
-      });
+  // 3.3 If A =>* B, B -> x in P2, and B -> x is not an unit,
+  // then insert A -> x to P3
+  ProdArena P3;
+  for(auto A: vars) {
+    auto reachable = &reach[component[A.id] * words];
+    for(size_t i=0; i<words; i++) {
+      for(auto bits = reachable[i]; bits; bits &= bits - 1) {
+        auto d = i * 64 + __builtin_ctzll(bits);
+        for(auto m=members_begin[d]; m<members_begin[d + 1]; m++) {
+          auto B = members[m];
+          for(auto p=ranges[B.id].first; p<ranges[B.id].second; p++) {
+            auto prod = G2.prods[p];
+            if (!prod.is_unit()) P3.push_back(A, prod.rhs);
+          }
+        }
+      }
+    }
   }
-  // 2.4 G2 == G1
-  CFG G2 { G1.start, {} };
-  copy(RANGE(P2_set), back_inserter(G2.prods));
-  sort(RANGE(G2.prods));
-  return G2;
+  // 3.4 G3 == G2
+  return G2.with_prods(move(P3));
 }
 
-static Prod term_to_prod(Symbol::Term term) {
-  string name;
-  if (isdigit(term.value)) {
-    stringstream ss;
-    ss << "A" << (char)term.value;
-    name = ss.str();
+/// Digits become A<d> and the homework operators B0..B5; any other
+/// terminal is named after its character code, T<hex>.
+static string term_var_name(Term term) {
+  static const char operators[] = "+-*/()";
+  auto c = (unsigned char)term.value;
+  stringstream ss;
+  if (isdigit(c)) {
+    ss << "A" << (char)c;
+  } else if (c != 0 && strchr(operators, c)) {
+    ss << "B" << strchr(operators, c) - operators;
   } else {
-    switch(term.value) {
-    case '+': name = "B0"; break;
-    case '-': name = "B1"; break;
-    case '*': name = "B2"; break;
-    case '/': name = "B3"; break;
-    case '(': name = "B4"; break;
-    case ')': name = "B5"; break;
-    default: throw runtime_error("out of homework specification");
-    }
+    ss << "T" << hex << (int)c;
   }
-  return Prod { Symbol::Var(name), { term } };
+  return ss.str();
 }
 
-// Implements 3
-CFG to_cnf(const CFG& cfg) {
-  auto G1 = remove_epsilon(cfg);
-  auto G2 = remove_unit_paths(G1);
-
-  CFG G3 { G2.start, {} };
-  std::unordered_set<Prod> P3;
-
-  for(auto prod: G2.prods) {
-    // 3.1 Insert A -> a into P3
+/// Implements 4
+static CFG terms_to_vars(const CFG& G3) {
+  CFG G4 { G3.start, {} };
+  G4.next_ids = G3.next_ids;
+  G4.prods.reserve(G3.prods.size(), G3.prods.size() * 2);
+  // The grammar may already use a terminal variable's name, e.g. when it
+  // was read back from our own output; those terminals get fresh names.
+  vector<bool> used(G3.var_id_bound(), false);
+  for(auto prod: G3.prods) {
+    used[prod.lhs.id] = true;
+    for(auto sym: prod.rhs) {
+      if (sym.is_var()) used[sym.as_var().id] = true;
+    }
+  }
+  vector<int64_t> term_vars(256, -1);
+  auto term_to_var = [&](Term term) {
+    auto& id = term_vars[(unsigned char)term.value];
+    if (id < 0) {
+      Var var(term_var_name(term));
+      if (var.id < used.size() && used[var.id]) var = G4.new_id();
+      id = var.id;
+      G4.prods.push_back(var, { term });
+    }
+    return Var::from_id(id);
+  };
+  for(auto prod: G3.prods) {
+    // 4.1 Insert A -> a into P4
     if (prod.rhs.size() == 1) {
-      P3.insert(prod);
+      assert(prod.rhs[0].is_term());
+      G4.prods.push_back(prod);
       continue;
     }
-    // 3.2 Transform terminal to Ca -> a
-    vector<Symbol> rhs;
-    transform(RANGE(prod.rhs), back_inserter(rhs), [&](auto sym) {
-        if (sym.is_var()) return sym;
-        auto prod = term_to_prod(sym.as_term());
-        P3.insert(prod);
-        return Symbol(prod.lhs);
-      });
-    // 3.3 Intermediate variable and normalizing
-    auto lhs = prod.lhs;
-    for(size_t i=rhs.size() -1; i >= 2; i--) {
-      auto next_lhs = G3.new_id();
-      auto prod = Prod { lhs, { next_lhs, rhs[i] }};
-      P3.insert(prod);
-      lhs = next_lhs;
+    // 4.2 Transform terminal to Ca -> a
+    Symbol rhs[2] = { prod.rhs[0], prod.rhs[1] };
+    for(auto& sym: rhs) {
+      if (sym.is_term()) sym = term_to_var(sym.as_term());
     }
-    P3.insert({lhs, { rhs[0], rhs[1]}});
+    G4.prods.push_back(prod.lhs, rhs, 2, prod.weight);
   }
-  // 3.4 G3 == G2
-  copy(RANGE(P3), back_inserter(G3.prods));
-  sort(RANGE(G3.prods));
-  return G3;
+  // 4.3 G4 == G3
+  G4.prods.normalize();
+  return G4;
+}
+
+/// Binarization runs before epsilon removal to keep the number of
+/// epsilon-replaced variants linear in the grammar size.
+CFG to_cnf(const CFG& cfg) {
+  auto G1 = binarize(remove_useless(cfg));
+  auto G2 = remove_epsilon(G1);
+  auto G3 = remove_unit_paths(G2);
+  auto G4 = simplify(terms_to_vars(G3));
+  G4.prods.sort([](const ProdView& a, const ProdView& b) { return a < b; });
+  return G4;
 }
@@ -3,6 +3,9 @@
 #ifndef _TO_CNF_
 #define _TO_CNF_
 
+/// Weights follow the best derivation: merged duplicates, removed epsilon
+/// and unit productions keep the highest weight, so the result has the
+/// same Viterbi scores as cfg but not the same inside scores.
 CFG to_cnf(const CFG& cfg);
 
 #endif
@@ -0,0 +1,270 @@
+#include "weighted_cnf.hpp"
+#include "compiled_cnf.hpp"
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+// The AVX2 kernels are compiled for that target alone and picked at
+// startup when the CPU has it, so the build needs no -mavx2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+#define RANGE(x) begin(x), end(x)
+
+/// max_k l[k] + r[k]
+static float max_plus_scalar(const float* l, const float* r, size_t n) {
+  float best = -INFINITY;
+  for (size_t k = 0; k < n; k++) best = max(best, l[k] + r[k]);
+  return best;
+}
+
+/// sum_k f[k] * l[k] * r[k]
+static float sum_product_scalar(const float* f, const float* l, const float* r, size_t n) {
+  float sum = 0;
+  for (size_t k = 0; k < n; k++) sum += f[k] * l[k] * r[k];
+  return sum;
+}
+
+#if AVX2_KERNELS
+__attribute__((target("avx2")))
+static float max_plus_avx2(const float* l, const float* r, size_t n) {
+  auto acc = _mm256_set1_ps(-INFINITY);
+  size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    acc = _mm256_max_ps(acc, _mm256_add_ps(_mm256_loadu_ps(l + k), _mm256_loadu_ps(r + k)));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  float best = max_plus_scalar(l + k, r + k, n - k);
+  for (auto lane: lanes) best = max(best, lane);
+  return best;
+}
+
+__attribute__((target("avx2")))
+static float sum_product_avx2(const float* f, const float* l, const float* r, size_t n) {
+  auto acc = _mm256_setzero_ps();
+  size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    auto lr = _mm256_mul_ps(_mm256_loadu_ps(l + k), _mm256_loadu_ps(r + k));
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(f + k), lr));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+  float sum = sum_product_scalar(f + k, l + k, r + k, n - k);
+  for (auto lane: lanes) sum += lane;
+  return sum;
+}
+#endif
+
+/// The split kernels of score(), the AVX2 ones when the CPU supports them
+struct Kernels {
+  float (*max_plus)(const float* l, const float* r, size_t n) = max_plus_scalar;
+  float (*sum_product)(const float* f, const float* l, const float* r, size_t n) = sum_product_scalar;
+
+  Kernels() {
+#if AVX2_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      max_plus = max_plus_avx2;
+      sum_product = sum_product_avx2;
+    }
+#endif
+  }
+};
+
+static const Kernels kernels;
+
+void ScoreChart::reset(size_t n, size_t vars, float zero) {
+  this->n = n;
+  this->vars = vars;
+  this->cells.assign(n * n * vars, zero);
+  this->scales.assign(n * n, 0);
+  this->by_start.assign(n * vars * (n + 1), zero);
+  this->by_end.assign((n + 1) * vars * (n + 1), zero);
+  this->starts.assign(n * vars, false);
+  this->ends.assign((n + 1) * vars, false);
+}
+
+WeightedCNF::WeightedCNF(const CFG& cfg) {
+  if (!is_cnf(cfg)) {
+    throw runtime_error("out of homework specification. input must be a CNF");
+  }
+  vector<int> index(cfg.var_id_bound(), -1);
+  auto index_var = [&](Symbol::Var var) {
+    if (index[var.id] < 0) {
+      index[var.id] = vars.size();
+      vars.push_back(var);
+    }
+    return index[var.id];
+  };
+  start = index_var(cfg.start);
+  for(auto prod: cfg.prods) {
+    index_var(prod.lhs);
+    for(auto sym: prod.rhs) {
+      if (sym.is_var()) index_var(sym.as_var());
+    }
+  }
+
+  term_weights.assign(256 * vars.size(), -INFINITY);
+  term_probs.assign(256 * vars.size(), 0);
+  for(auto prod: cfg.prods) {
+    uint32_t A = index[prod.lhs.id];
+    if (prod.rhs.size() == 1) {
+      auto at = (unsigned char)prod.rhs[0].as_term().value * vars.size() + A;
+      term_weights[at] = max(term_weights[at], prod.weight);
+      term_probs[at] += exp(prod.weight);
+      continue;
+    }
+    uint32_t B = index[prod.rhs[0].as_var().id];
+    uint32_t C = index[prod.rhs[1].as_var().id];
+    rules.push_back(Rule { A, B, C, prod.weight });
+  }
+  stable_sort(RANGE(rules), [](const Rule& a, const Rule& b) { return a.lhs < b.lhs; });
+  rule_begin.assign(vars.size() + 1, 0);
+  for(auto& rule: rules) {
+    rule_begin[rule.lhs + 1]++;
+  }
+  for(size_t A=0; A<vars.size(); A++) {
+    rule_begin[A + 1] += rule_begin[A];
+  }
+}
+
+float WeightedCNF::score(const string& a, Semiring semiring) const {
+  ScoreChart chart;
+  return score(a, semiring, chart);
+}
+
+float WeightedCNF::score(const string& a, Semiring semiring, ScoreChart& chart) const {
+  auto n = a.size();
+  if (n == 0) return -INFINITY;
+  auto V = vars.size();
+  auto inside = semiring == Semiring::Inside;
+  auto zero = inside ? 0.0f : -INFINITY;
+  chart.reset(n, V, zero);
+
+  // Inside scores are probabilities; scale every cell so that its largest
+  // score is 1, and keep the scale's log
+  auto finish_cell = [&](size_t i, size_t len, float scale) {
+    auto cell = chart.cell(i, len);
+    if (inside) {
+      auto largest = *max_element(cell, cell + V);
+      if (largest > 0) {
+        for(size_t A=0; A<V; A++) cell[A] /= largest;
+        scale += log(largest);
+      }
+      chart.scales[(len - 1) * n + i] = scale;
+    }
+    auto j = i + len;
+    for(size_t A=0; A<V; A++) {
+      if (cell[A] == zero) continue;
+      chart.by_start[(i * V + A) * (n + 1) + len] = cell[A];
+      chart.by_end[(j * V + A) * (n + 1) + i] = cell[A];
+      chart.starts[i * V + A] = true;
+      chart.ends[j * V + A] = true;
+    }
+  };
+
+  for(size_t i=0; i<n; i++) {
+    auto row = (unsigned char)a[i] * V;
+    auto weights = inside ? &term_probs[row] : &term_weights[row];
+    auto cell = chart.cell(i, 1);
+    copy(weights, weights + V, cell);
+    finish_cell(i, 1, 0);
+  }
+
+  vector<float> factors(n);
+  vector<float> probs;
+  for(auto& rule: rules) probs.push_back(exp(rule.weight));
+  for(size_t len=2; len<=n; len++) {
+    auto splits = len - 1;
+    for(size_t i=0; i + len <= n; i++) {
+      auto j = i + len;
+      auto cell = chart.cell(i, len);
+      // split k pairs cell (i, k) with cell (i + k, len - k); under Inside
+      // their scales differ per split and are folded into factors[k - 1]
+      float scale = 0;
+      if (inside) {
+        scale = -INFINITY;
+        for(size_t k=1; k<len; k++) {
+          factors[k - 1] = chart.scales[(k - 1) * n + i] + chart.scales[(len - k - 1) * n + i + k];
+          scale = max(scale, factors[k - 1]);
+        }
+        for(size_t k=0; k<splits; k++) factors[k] = exp(factors[k] - scale);
+      }
+      for(size_t r=0; r<rules.size(); r++) {
+        auto& rule = rules[r];
+        if (!chart.starts[i * V + rule.left] || !chart.ends[j * V + rule.right]) continue;
+        auto left = &chart.by_start[(i * V + rule.left) * (n + 1) + 1];
+        auto right = &chart.by_end[(j * V + rule.right) * (n + 1) + i + 1];
+        if (inside) {
+          cell[rule.lhs] += probs[r] * kernels.sum_product(factors.data(), left, right, splits);
+        } else {
+          cell[rule.lhs] = max(cell[rule.lhs], kernels.max_plus(left, right, splits) + rule.weight);
+        }
+      }
+      finish_cell(i, len, scale);
+    }
+  }
+
+  auto root = chart.cell(0, n)[start];
+  if (!inside) return root;
+  return root > 0 ? log(root) + chart.scales[(n - 1) * n] : -INFINITY;
+}
+
+vector<ParseNode> WeightedCNF::best_parse(const string& a, const ScoreChart& chart) const {
+  vector<ParseNode> nodes;
+  auto n = a.size();
+  if (n == 0 || chart.n != n || chart.cell(0, n)[start] == -INFINITY) return nodes;
+  nodes.push_back(ParseNode { vars[start], 0, n });
+  for(size_t i=0; i<nodes.size(); i++) {
+    auto node = nodes[i];
+    if (node.symbol.is_term()) continue;
+    auto A = find(RANGE(vars), node.symbol.as_var()) - begin(vars);
+    if (node.len == 1) {
+      nodes[i].left = nodes.size();
+      nodes.push_back(ParseNode { Symbol::Term(a[node.start]), node.start, 1 });
+      continue;
+    }
+    // the score is exactly one of the sums the chart maximized over
+    auto target = chart.cell(node.start, node.len)[A];
+    bool found = false;
+    for(auto r=rule_begin[A]; r<rule_begin[A + 1] && !found; r++) {
+      auto& rule = rules[r];
+      for(size_t k=1; k<node.len && !found; k++) {
+        auto left = chart.cell(node.start, k)[rule.left];
+        auto right = chart.cell(node.start + k, node.len - k)[rule.right];
+        if (left + right + rule.weight != target) continue;
+        found = true;
+        nodes[i].left = nodes.size();
+        nodes.push_back(ParseNode { vars[rule.left], node.start, k });
+        nodes[i].right = nodes.size();
+        nodes.push_back(ParseNode { vars[rule.right], node.start + k, node.len - k });
+      }
+    }
+    if (!found) throw runtime_error("chart was not filled by Viterbi");
+  }
+  return nodes;
+}
+
+static void print_node(ostream& os, const vector<ParseNode>& nodes, int i) {
+  auto& node = nodes[i];
+  if (node.symbol.is_term()) {
+    os << node.symbol;
+    return;
+  }
+  os << "(" << node.symbol;
+  for(auto child: { node.left, node.right }) {
+    if (child < 0) continue;
+    os << " ";
+    print_node(os, nodes, child);
+  }
+  os << ")";
+}
+
+void print_parse(ostream& os, const vector<ParseNode>& nodes) {
+  if (!nodes.empty()) print_node(os, nodes, 0);
+}
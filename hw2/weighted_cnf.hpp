@@ -0,0 +1,93 @@
+#include "cfg.hpp"
+
+#ifndef _WEIGHTED_CNF_
+#define _WEIGHTED_CNF_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+/// How the scores of alternative derivations combine
+enum class Semiring {
+  /// the best derivation; max-plus over log-probabilities
+  Viterbi,
+  /// all derivations; sum-product over probabilities, rescaled per cell
+  Inside,
+};
+
+/// Score chart of one string. Cell (i, len) is a dense vector over the
+/// variables. Every score is also stored by start and by end position, so
+/// for a fixed variable the splits of a cell are contiguous.
+struct ScoreChart {
+  size_t n = 0;
+  size_t vars = 0;
+  std::vector<float> cells;
+  /// Inside only: the log scale of each cell, whose scores are divided by it
+  std::vector<float> scales;
+  /// [(i * vars + A) * (n + 1) + len] = cell (i, len)
+  std::vector<float> by_start;
+  /// [(j * vars + A) * (n + 1) + i] = cell (i, j - i)
+  std::vector<float> by_end;
+  /// whether any cell starting (ending) at a position has a score for A
+  std::vector<bool> starts;
+  std::vector<bool> ends;
+
+  void reset(size_t n, size_t vars, float zero);
+
+  float* cell(size_t i, size_t len) {
+    return &cells[((len - 1) * n + i) * vars];
+  }
+  const float* cell(size_t i, size_t len) const {
+    return &cells[((len - 1) * n + i) * vars];
+  }
+};
+
+/// A node of a derivation: a variable over [start, start + len) with one or
+/// two children, or a terminal leaf.
+struct ParseNode {
+  Symbol symbol;
+  size_t start;
+  size_t len;
+  int left = -1;
+  int right = -1;
+};
+
+/// Prints nodes[0] and its descendants as (<A> (<B> 2) (<C> +))
+void print_parse(std::ostream&, const std::vector<ParseNode>&);
+
+/// A weighted CNF grammar preprocessed for probabilistic CYK. Productions
+/// carry log-probabilities; variables are numbered densely.
+struct WeightedCNF {
+  struct Rule {
+    uint32_t lhs;
+    uint32_t left;
+    uint32_t right;
+    float weight;
+  };
+
+  std::vector<Symbol::Var> vars;
+  int start = -1;
+  /// 256 rows of `vars` log-probabilities of the best A -> c, -inf if
+  /// absent
+  std::vector<float> term_weights;
+  /// the same rows with the probabilities of every A -> c summed, 0 if
+  /// absent; duplicates count like the A -> BC rules do under Inside
+  std::vector<float> term_probs;
+  /// A -> BC rules, those of A are [rule_begin[A], rule_begin[A+1])
+  std::vector<Rule> rules;
+  std::vector<uint32_t> rule_begin;
+
+  /// throws std::runtime_error if the grammar is not in CNF
+  explicit WeightedCNF(const CFG&);
+
+  /// log-probability of the best derivation (Viterbi) or of all of them
+  /// (Inside); -inf if the string is not derived
+  float score(const std::string&, Semiring) const;
+  float score(const std::string&, Semiring, ScoreChart& chart) const;
+  /// the best derivation, from a chart filled by a Viterbi score();
+  /// empty if the string is not derived
+  std::vector<ParseNode> best_parse(const std::string&, const ScoreChart& chart) const;
+};
+
+#endif
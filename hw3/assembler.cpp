@@ -0,0 +1,259 @@
+#include "assembler.hpp"
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+assemble_error::assemble_error(const std::string& whatarg, size_t line)
+  : std::runtime_error("line " + std::to_string(line) + ": " + whatarg), line(line) { }
+
+namespace {
+
+using Words = std::vector<std::string>;
+
+Words split(const std::string& line) {
+  Words words;
+  size_t at = 0;
+  for(;;) {
+    at = line.find_first_not_of(" \t\r", at);
+    if (at == std::string::npos) break;
+    auto end = line.find_first_of(" \t\r", at);
+    if (end == std::string::npos) end = line.size();
+    words.emplace_back(line, at, end - at);
+    at = end;
+  }
+  return words;
+}
+
+struct Entry {
+  bool valid = false;
+  char write;
+  Move move;
+  /* -1 until the label is declared */
+  int to;
+};
+
+struct Label {
+  int state = -1;
+  /* entries waiting for the label, as state * 29 + symbol */
+  std::vector<size_t> fixups;
+  size_t first_use = 0;
+};
+
+struct Macro {
+  Words parameters;
+  std::vector<Words> body;
+};
+
+class Assembler {
+public:
+  Table finish(size_t line);
+  /* one statement; line is where it comes from in the source */
+  void statement(const Words& words, size_t line, int depth);
+  bool ended = false;
+
+private:
+  static const int max_symbols = 29;
+  static const int max_depth = 64;
+
+  std::unordered_map<std::string, Label> labels;
+  std::unordered_map<std::string, Macro> macros;
+  /* entries of every state, max_symbols per state */
+  std::vector<Entry> entries;
+  std::vector<bool> halt;
+  int K = 0;
+  uint64_t uses = 0;
+  /* the macro being defined */
+  Macro* defining = nullptr;
+
+  int symbol(const std::string& word, size_t line);
+  Move move(const std::string& word, size_t line);
+  void declare(const std::string& name, bool halting, size_t line);
+  void transition(const Words& words, size_t line);
+  void use(const Words& words, size_t line, int depth);
+};
+
+int Assembler::symbol(const std::string& word, size_t line) {
+  if (word.size() == 1) {
+    auto c = word[0];
+    if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+    auto index = to_symbol(c);
+    if (index >= 0) {
+      if (index >= 3) K = std::max(K, index - 2);
+      return index;
+    }
+  }
+  throw assemble_error("not a symbol: " + word, line);
+}
+
+Move Assembler::move(const std::string& word, size_t line) {
+  if (word.size() == 1) {
+    switch(word[0]) {
+    case 'S': case 's': return Move::S;
+    case 'L': case 'l': return Move::L;
+    case 'R': case 'r': return Move::R;
+    }
+  }
+  throw assemble_error("not a move: " + word, line);
+}
+
+void Assembler::declare(const std::string& name, bool halting, size_t line) {
+  auto& label = labels[name];
+  if (label.state >= 0) {
+    throw assemble_error("label declared twice: " + name, line);
+  }
+  label.state = halt.size();
+  halt.push_back(halting);
+  entries.resize(entries.size() + max_symbols);
+  for(auto at: label.fixups) {
+    entries[at].to = label.state;
+  }
+  label.fixups.clear();
+  label.fixups.shrink_to_fit();
+}
+
+void Assembler::transition(const Words& words, size_t line) {
+  if (halt.empty()) {
+    throw assemble_error("transition before the first label", line);
+  }
+  if (words.size() != 4) {
+    throw assemble_error("a transition is: read write move label", line);
+  }
+  auto read = symbol(words[0], line);
+  auto at = (halt.size() - 1) * max_symbols + read;
+  auto& entry = entries[at];
+  if (entry.valid) {
+    throw assemble_error("second transition on " + words[0], line);
+  }
+  entry.valid = true;
+  entry.write = alphabets[symbol(words[1], line)];
+  entry.move = move(words[2], line);
+
+  auto& label = labels[words[3]];
+  entry.to = label.state;
+  if (label.state < 0) {
+    if (label.fixups.empty()) label.first_use = line;
+    label.fixups.push_back(at);
+  }
+}
+
+void Assembler::use(const Words& words, size_t line, int depth) {
+  if (words.size() < 2) {
+    throw assemble_error("@use needs a macro name", line);
+  }
+  auto it = macros.find(words[1]);
+  if (it == macros.end()) {
+    throw assemble_error("unknown macro: " + words[1], line);
+  }
+  auto& macro = it->second;
+  if (words.size() - 2 != macro.parameters.size()) {
+    throw assemble_error("macro " + words[1] + " takes "
+                         + std::to_string(macro.parameters.size()) + " arguments", line);
+  }
+  if (depth == max_depth) {
+    throw assemble_error("macros nested too deep in " + words[1], line);
+  }
+
+  auto suffix = "@" + std::to_string(++uses);
+  for(auto& body: macro.body) {
+    auto expanded = body;
+    for(auto& word: expanded) {
+      auto parameter = std::find(std::begin(macro.parameters), std::end(macro.parameters), word);
+      if (parameter != std::end(macro.parameters)) {
+        word = words[2 + (parameter - std::begin(macro.parameters))];
+      } else if (word.size() > 1 && word[0] == '.') {
+        word += suffix;
+      }
+    }
+    /* errors inside the body point at the @use */
+    statement(expanded, line, depth + 1);
+  }
+}
+
+void Assembler::statement(const Words& words, size_t line, int depth) {
+  if (words.empty()) {
+    return;
+  }
+  auto& first = words[0];
+  if (defining) {
+    if (first.compare("@end") == 0) {
+      defining = nullptr;
+    } else if (first.compare("@macro") == 0) {
+      throw assemble_error("@macro inside a macro", line);
+    } else {
+      defining->body.push_back(words);
+    }
+    return;
+  }
+
+  if (first.compare("=") == 0) {
+    ended = true;
+  } else if (first.compare("-") == 0 || first.compare("h") == 0) {
+    if (words.size() != 2) {
+      throw assemble_error("a label is: - name or h name", line);
+    }
+    declare(words[1], first.compare("h") == 0, line);
+  } else if (first.compare("@macro") == 0) {
+    if (words.size() < 2) {
+      throw assemble_error("@macro needs a name", line);
+    }
+    auto inserted = macros.emplace(words[1], Macro());
+    if (!inserted.second) {
+      throw assemble_error("macro defined twice: " + words[1], line);
+    }
+    auto& macro = inserted.first->second;
+    macro.parameters.assign(std::begin(words) + 2, std::end(words));
+    defining = &macro;
+  } else if (first.compare("@use") == 0) {
+    use(words, line, depth);
+  } else if (first.compare("@end") == 0) {
+    throw assemble_error("@end outside a macro", line);
+  } else {
+    transition(words, line);
+  }
+}
+
+Table Assembler::finish(size_t line) {
+  if (defining) {
+    throw assemble_error("macro without @end", line);
+  }
+  if (halt.empty()) {
+    throw assemble_error("no states", line);
+  }
+  /* report the earliest dangling reference */
+  const std::pair<const std::string, Label>* dangling = nullptr;
+  for(auto& label: labels) {
+    if (label.second.state < 0
+        && (!dangling || label.second.first_use < dangling->second.first_use)) {
+      dangling = &label;
+    }
+  }
+  if (dangling) {
+    throw assemble_error("undeclared label: " + dangling->first, dangling->second.first_use);
+  }
+
+  int num_symbols = 3 + K;
+  std::vector<Transition> transitions;
+  transitions.reserve(halt.size() * num_symbols);
+  for(size_t state=0; state<halt.size(); state++) {
+    for(int symbol=0; symbol<num_symbols; symbol++) {
+      auto& entry = entries[state * max_symbols + symbol];
+      transitions.push_back(entry.valid ? Transition(entry.to, entry.write, entry.move)
+                                        : Transition());
+    }
+  }
+  int num_states = halt.size();
+  return Table(K, num_states, std::move(transitions), std::move(halt));
+}
+
+}
+
+Table assemble(std::istream& is) {
+  Assembler assembler;
+  size_t line = 0;
+  for(std::string text; !assembler.ended && std::getline(is, text);) {
+    assembler.statement(split(text), ++line, 0);
+  }
+  return assembler.finish(line);
+}
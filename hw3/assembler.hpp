@@ -0,0 +1,34 @@
+#ifndef _ASSEMBLER_H_
+#define _ASSEMBLER_H_
+
+#include "machine.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/* Assembles the label language of tr into a Table. One statement per line:
+     - name             starts the state labelled name
+     h name             starts the halting state labelled name
+     read write move to transition of the current state; symbols and moves
+                        may be upper case, to is a label declared anywhere
+     =                  ends the program
+     @macro name p...   starts a macro with parameters p..., up to @end
+     @use name a...     copies the macro body with every word equal to a
+                        parameter replaced by its argument; labels starting
+                        with "." get a suffix unique to this use
+   States are numbered in the order they are declared. Labels are resolved
+   in one pass: a transition to a label not declared yet is recorded and
+   patched when the label is declared. */
+class assemble_error : public std::runtime_error {
+public:
+  /* prefixes whatarg with "line N: ", 1-based */
+  assemble_error(const std::string& whatarg, size_t line);
+  size_t line;
+};
+
+/* reads lines up to "=" or the end of the stream, so whatever follows
+   "=" is left in is */
+Table assemble(std::istream& is);
+
+#endif
@@ -0,0 +1,41 @@
+#include "batch.hpp"
+#include "macro.hpp"
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <algorithm>
+
+std::vector<Execution> run_batch(const Table& table,
+                                 const std::vector<std::string>& inputs,
+                                 const Limits& limits,
+                                 unsigned threads,
+                                 int block_size) {
+  assert(debug_transition == false);
+  std::vector<Execution> results(inputs.size(),
+                                 Execution { Outcome::Undefined, Tape(""), 0, 0 });
+  /* inputs are taken one at a time, so long runs do not hold up a worker's
+     share of short ones */
+  std::atomic<size_t> next { 0 };
+  auto worker = [&]() {
+    std::unique_ptr<MacroMachine> machine;
+    if (block_size > 0) {
+      machine.reset(new MacroMachine(table, block_size));
+    }
+    for(size_t i; (i = next++) < inputs.size();) {
+      results[i] = machine ? machine->run(inputs[i], limits)
+                           : run(table, Tape(inputs[i]), limits);
+    }
+  };
+
+  threads = std::max(1u, std::min<unsigned>(threads, inputs.size()));
+  std::vector<std::thread> pool;
+  for(unsigned i=1; i<threads; i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for(auto& thread: pool) {
+    thread.join();
+  }
+  return results;
+}
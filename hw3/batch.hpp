@@ -0,0 +1,19 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "machine.hpp"
+
+#include <string>
+#include <vector>
+
+/* Runs every input under the same limits on a pool of threads and returns
+   the executions in input order. The table is shared read-only; with a
+   block size every thread keeps its own MacroMachine, so its cache stays
+   warm across the inputs it takes. debug_transition must be off. */
+std::vector<Execution> run_batch(const Table& table,
+                                 const std::vector<std::string>& inputs,
+                                 const Limits& limits,
+                                 unsigned threads,
+                                 int block_size = 0);
+
+#endif
@@ -0,0 +1,122 @@
+#include "binary.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char magic[] = "TMTABLE1";
+static const size_t header_size = sizeof(magic) - 1 + 8;
+
+static_assert(sizeof(Transition) == 4, "transitions are stored as 32-bit words");
+
+static bool little_endian() {
+  uint32_t one = 1;
+  unsigned char first;
+  std::memcpy(&first, &one, 1);
+  return first == 1;
+}
+
+static void put_word(std::string& out, uint32_t value) {
+  for(int i=0; i<4; i++) {
+    out.push_back((char)(value >> (8 * i)));
+  }
+}
+
+static uint32_t get_word(const char* in) {
+  uint32_t value = 0;
+  for(int i=0; i<4; i++) {
+    value |= (uint32_t)(unsigned char)in[i] << (8 * i);
+  }
+  return value;
+}
+
+std::string encode_table(const Table& table) {
+  std::string out(magic, sizeof(magic) - 1);
+  put_word(out, table.K);
+  put_word(out, table.num_states);
+  if (little_endian()) {
+    out.append((const char*)table.transitions.data(), 4 * table.transitions.size());
+  } else {
+    for(auto& tr: table.transitions) {
+      put_word(out, tr.bits);
+    }
+  }
+  std::string bitmap((table.num_states + 7) / 8, '\0');
+  for(int i=0; i<table.num_states; i++) {
+    if (table.halt[i]) {
+      bitmap[i / 8] |= (char)(1 << (i % 8));
+    }
+  }
+  return out + bitmap;
+}
+
+bool decode_table(const char* bytes, size_t size, Table& table) {
+  if (size < header_size || std::memcmp(bytes, magic, sizeof(magic) - 1) != 0) {
+    return false;
+  }
+  auto K = get_word(bytes + sizeof(magic) - 1);
+  auto N = get_word(bytes + sizeof(magic) + 3);
+  if (K > 26 || N == 0 || N >= (1u << 24)) {
+    return false;
+  }
+  size_t entries = (size_t)N * (3 + K);
+  if (size != header_size + 4 * entries + (N + 7) / 8) {
+    return false;
+  }
+
+  std::vector<Transition> transitions(entries);
+  auto words = bytes + header_size;
+  if (little_endian()) {
+    std::memcpy(transitions.data(), words, 4 * entries);
+  } else {
+    for(size_t i=0; i<entries; i++) {
+      transitions[i].bits = get_word(words + 4 * i);
+    }
+  }
+  /* the runners index the table with these without checks */
+  for(auto& tr: transitions) {
+    if (tr.valid() && (tr.state_to() >= (int)N || tr.write_symbol() >= (int)(3 + K)
+                       || (tr.bits >> 1 & 3) == 3)) {
+      return false;
+    }
+  }
+
+  auto bitmap = words + 4 * entries;
+  std::vector<bool> halt(N);
+  for(uint32_t i=0; i<N; i++) {
+    halt[i] = bitmap[i / 8] >> (i % 8) & 1;
+  }
+  table = Table(K, N, std::move(transitions), std::move(halt));
+  return true;
+}
+
+bool save_table(const std::string& path, const Table& table) {
+  auto bytes = encode_table(table);
+  std::ofstream os { path, std::ios::binary };
+  os.write(bytes.data(), bytes.size());
+  os.close();
+  return (bool)os;
+}
+
+bool load_table(const std::string& path, Table& table) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)header_size) {
+    close(fd);
+    return false;
+  }
+  auto mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  auto decoded = decode_table((const char*)mapped, st.st_size, table);
+  munmap(mapped, st.st_size);
+  return decoded;
+}
@@ -0,0 +1,27 @@
+#ifndef _BINARY_H_
+#define _BINARY_H_
+
+#include "machine.hpp"
+
+#include <string>
+
+/* Tables in binary form, laid out as
+     "TMTABLE1", 32-bit K, 32-bit state count,
+     one 32-bit packed Transition per entry of the flat table,
+     the halt bitmap with state i in bit i % 8 of byte i / 8
+   with every integer little endian. The transitions are stored exactly as
+   Table keeps them, so loading is a bounds check and one copy. */
+std::string encode_table(const Table& table);
+
+/* false when the bytes are not a whole table, the table has no states,
+   or a transition names a state or symbol the table does not have */
+bool decode_table(const char* bytes, size_t size, Table& table);
+
+/* false on any I/O error */
+bool save_table(const std::string& path, const Table& table);
+
+/* maps path and decodes it in place; false when path cannot be read or
+   does not hold a table */
+bool load_table(const std::string& path, Table& table);
+
+#endif
@@ -0,0 +1,202 @@
+#include "checkpoint.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const char magic[] = "TMSNAP01";
+
+/* cells a snapshot may expand to; longer tapes are taken as corrupt */
+static const uint64_t max_cells = 1ull << 30;
+
+/* steps between looks at the clock */
+static const uint64_t check_period = 1 << 22;
+
+static void put_varint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+static void put_signed(std::string& out, int64_t value) {
+  put_varint(out, (uint64_t)value << 1 ^ (uint64_t)(value >> 63));
+}
+
+static bool get_varint(const std::string& in, size_t& at, uint64_t& value) {
+  value = 0;
+  for(int shift=0; shift<64; shift+=7) {
+    if (at == in.size()) {
+      return false;
+    }
+    auto byte = (unsigned char)in[at++];
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool get_signed(const std::string& in, size_t& at, int64_t& value) {
+  uint64_t zigzag;
+  if (!get_varint(in, at, zigzag)) {
+    return false;
+  }
+  value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+  return true;
+}
+
+std::string encode_snapshot(int state, uint64_t steps, const Tape& tape) {
+  auto pos = tape.pos();
+  auto first = std::min(pos, tape.left_end());
+  auto last = std::max(pos, tape.right_end());
+
+  std::string out(magic, sizeof(magic) - 1);
+  put_varint(out, state);
+  put_varint(out, steps);
+  put_signed(out, pos);
+  put_signed(out, first);
+
+  std::string runs;
+  uint64_t count = 0;
+  for(long i=first; i<=last;) {
+    auto c = tape.get(i);
+    long j = i;
+    while (j <= last && tape.get(j) == c) j++;
+    runs.push_back(c);
+    put_varint(runs, j - i);
+    count++;
+    i = j;
+  }
+  put_varint(out, count);
+  return out + runs;
+}
+
+bool decode_snapshot(const std::string& bytes, Snapshot& snapshot) {
+  if (bytes.compare(0, sizeof(magic) - 1, magic) != 0) {
+    return false;
+  }
+  size_t at = sizeof(magic) - 1;
+  uint64_t state, steps, count;
+  int64_t pos, first;
+  if (!get_varint(bytes, at, state) || !get_varint(bytes, at, steps)
+      || !get_signed(bytes, at, pos) || !get_signed(bytes, at, first)
+      || !get_varint(bytes, at, count) || state > INT_MAX) {
+    return false;
+  }
+
+  /* every run takes at least two bytes; check them all and add up their
+     lengths before any cell is allocated */
+  if (count > (bytes.size() - at) / 2) {
+    return false;
+  }
+  auto runs = at;
+  uint64_t total = 0;
+  for(uint64_t i=0; i<count; i++) {
+    uint64_t length;
+    if (at++ == bytes.size() || !get_varint(bytes, at, length)
+        || length == 0 || length > max_cells - total) {
+      return false;
+    }
+    total += length;
+  }
+  if (at != bytes.size() || pos < first || (uint64_t)pos - (uint64_t)first >= total) {
+    return false;
+  }
+
+  std::string cells;
+  cells.reserve(total);
+  for(at=runs; at<bytes.size();) {
+    uint64_t length;
+    auto c = bytes[at++];
+    get_varint(bytes, at, length);
+    cells.append(length, c);
+  }
+
+  /* Tape puts the cells at position 0; shift them to where they were */
+  Tape tape { cells };
+  tape.origin -= first;
+  tape.head = tape.cells.data() + tape.origin + pos;
+  snapshot = Snapshot { (int)state, steps, std::move(tape) };
+  return true;
+}
+
+bool save_snapshot(const std::string& path, int state, uint64_t steps, const Tape& tape) {
+  auto bytes = encode_snapshot(state, steps, tape);
+  auto temporary = path + ".tmp";
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  for(size_t written=0; written<bytes.size();) {
+    auto n = write(fd, bytes.data() + written, bytes.size() - written);
+    if (n < 0) {
+      close(fd);
+      return false;
+    }
+    written += n;
+  }
+  if (fsync(fd) != 0 || close(fd) != 0) {
+    return false;
+  }
+  return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool load_snapshot(const std::string& path, Snapshot& snapshot) {
+  std::ifstream is { path, std::ios::binary };
+  if (!is) {
+    return false;
+  }
+  std::string bytes { std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>() };
+  return decode_snapshot(bytes, snapshot);
+}
+
+Execution run_checkpointed(const Table& table, Snapshot start, const Limits& limits,
+                           const std::string& path, double interval) {
+  using clock = std::chrono::steady_clock;
+  auto last_saved = clock::now();
+  pid_t writer = 0;
+
+  Execution execution { Outcome::Timeout, std::move(start.tape), start.steps, start.state };
+  for(;;) {
+    auto chunk = limits;
+    chunk.steps = execution.steps + std::min(check_period, limits.steps - execution.steps);
+    execution = run(table, std::move(execution.tape), chunk, execution.state, execution.steps);
+
+    /* stopped only for a look at the clock */
+    bool paused = execution.outcome == Outcome::Timeout && execution.steps < limits.steps
+      && execution.tape.cells.size() <= limits.cells;
+    if (!paused) {
+      break;
+    }
+
+    if (writer > 0 && waitpid(writer, nullptr, WNOHANG) != 0) {
+      writer = 0;
+    }
+    if (writer == 0 && std::chrono::duration<double>(clock::now() - last_saved).count() >= interval) {
+      last_saved = clock::now();
+      writer = fork();
+      if (writer == 0) {
+        _exit(save_snapshot(path, execution.state, execution.steps, execution.tape) ? 0 : 1);
+      }
+      if (writer < 0) {
+        /* no child to write it, so write it here */
+        writer = 0;
+        save_snapshot(path, execution.state, execution.steps, execution.tape);
+      }
+    }
+  }
+
+  if (writer > 0) {
+    waitpid(writer, nullptr, 0);
+  }
+  save_snapshot(path, execution.state, execution.steps, execution.tape);
+  return execution;
+}
@@ -0,0 +1,42 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include "machine.hpp"
+
+#include <string>
+
+/* A paused run: enough to pick it up with run(table, tape, limits, state,
+   steps). Snapshots are stored as
+     "TMSNAP01", varint state, varint steps, zigzag varint head position,
+     zigzag varint first cell position, varint run count,
+     then per run one byte of cell content and a varint length
+   covering the written extent of the tape and the head. */
+struct Snapshot {
+  int state;
+  uint64_t steps;
+  Tape tape;
+};
+
+std::string encode_snapshot(int state, uint64_t steps, const Tape& tape);
+
+/* false when the bytes are not a whole snapshot, or its tape would
+   expand to more than 2^30 cells */
+bool decode_snapshot(const std::string& bytes, Snapshot& snapshot);
+
+/* Writes the snapshot to path + ".tmp", syncs it and renames it over path,
+   so path always holds a whole snapshot; false on any I/O error */
+bool save_snapshot(const std::string& path, int state, uint64_t steps, const Tape& tape);
+
+/* false when path cannot be read or does not hold a snapshot */
+bool load_snapshot(const std::string& path, Snapshot& snapshot);
+
+/* run() that saves a snapshot to path about every `interval` seconds and
+   once more when the run stops. The snapshot is written by a forked
+   child, so the run goes on while the child serializes its copy-on-write
+   view of the tape; a checkpoint is skipped while the previous one is
+   still being written. Loop detection restarts at every checkpoint
+   check, so cycles longer than a check period are not found. */
+Execution run_checkpointed(const Table& table, Snapshot start, const Limits& limits,
+                           const std::string& path, double interval);
+
+#endif
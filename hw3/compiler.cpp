@@ -0,0 +1,114 @@
+#include "compiler.hpp"
+
+#include <string>
+
+/* tape buffer shared by every generated program, laid out like Tape */
+static const char* prologue = R"(#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+static std::vector<char> cells;
+
+/* doubles the buffer, keeping the old cells in the middle */
+static char* grow(char* head) {
+  auto offset = head - cells.data();
+  auto margin = (long)cells.size() / 2 + 1;
+  std::vector<char> grown(cells.size() + 2 * margin, '#');
+  std::copy(std::begin(cells), std::end(cells), std::begin(grown) + margin);
+  cells.swap(grown);
+  return cells.data() + offset + margin;
+}
+
+#define LEFT \
+  if (head == cells.data()) head = grow(head); \
+  head--;
+#define RIGHT \
+  if (head == cells.data() + cells.size() - 1) head = grow(head); \
+  head++;
+
+int main() {
+  std::string input;
+  std::cin >> input;
+  cells.assign(input.size() + 64, '#');
+  std::copy(std::begin(input), std::end(input), std::begin(cells) + 32);
+  char* head = &cells[31];
+)";
+
+static const char* epilogue = R"(
+halt: {
+  auto first = std::find_if(std::begin(cells), std::end(cells), [](char c) { return c != '#'; });
+  if (first == std::end(cells)) {
+    std::cout << "#" << std::endl;
+  } else {
+    auto last = std::find_if(cells.rbegin(), cells.rend(), [](char c) { return c != '#'; }).base();
+    std::cout << std::string(first, last) << std::endl;
+  }
+  return 0;
+}
+undefined:
+  /* it is infinite loop. exit with error */
+  exit(-1);
+}
+)";
+
+static std::string label(int state) {
+  return "s" + std::to_string(state);
+}
+
+static std::string arm(int state, int symbol) {
+  return label(state) + "_" + std::to_string(symbol);
+}
+
+void compile(const Table& table, std::ostream& os) {
+  os << prologue;
+
+  /* dense symbol of every byte, shared by all states; bytes outside the
+     table's alphabets get num_symbols, the undefined entry of every state */
+  os << "  static const unsigned char symbol_of[256] = {";
+  for(int c=0; c<256; c++) {
+    os << (c % 16 == 0 ? "\n    " : " ");
+    auto symbol = to_symbol((char)c);
+    os << (symbol >= 0 && symbol < table.num_symbols ? symbol : table.num_symbols) << ",";
+  }
+  os << "\n  };\n";
+  os << "  goto " << label(0) << ";\n";
+
+  for(int state=0; state<table.num_states; state++) {
+    os << "\n" << label(state) << ":\n";
+    if (table.is_halted(state)) {
+      os << "  goto halt;\n";
+      continue;
+    }
+
+    /* one entry per symbol and a last one for other bytes */
+    os << "  {\n    static void* const next[] = {";
+    for(int symbol=0; symbol<table.num_symbols; symbol++) {
+      if (table.get(state, symbol).valid()) {
+        os << " &&" << arm(state, symbol) << ",";
+      } else {
+        os << " &&undefined,";
+      }
+    }
+    os << " &&undefined };\n    goto *next[symbol_of[(unsigned char)*head]];\n  }\n";
+
+    for(int symbol=0; symbol<table.num_symbols; symbol++) {
+      auto transition = table.get(state, symbol);
+      if (transition.valid() == false) {
+        continue;
+      }
+      os << arm(state, symbol) << ":\n";
+      if (transition.write_symbol() != symbol) {
+        os << "  *head = '" << transition.write_to() << "';\n";
+      }
+      switch(transition.move_to()) {
+      case Move::S: break;
+      case Move::L: os << "  LEFT\n"; break;
+      case Move::R: os << "  RIGHT\n"; break;
+      }
+      os << "  goto " << label(transition.state_to()) << ";\n";
+    }
+  }
+  os << epilogue;
+}
@@ -0,0 +1,17 @@
+#ifndef _COMPILER_H_
+#define _COMPILER_H_
+
+#include "machine.hpp"
+
+#include <iostream>
+
+/* Writes a standalone C++ program that runs the table like run(): it
+   reads the input word from stdin and prints the final tape, exiting with
+   -1 on an undefined transition. Every state becomes a label. Reading
+   the head maps the byte to its symbol through one shared table and
+   dispatches through a per-state computed goto table of 3 + K + 1
+   entries, so the output needs the labels-as-values extension of g++
+   and clang++. */
+void compile(const Table& table, std::ostream& os);
+
+#endif
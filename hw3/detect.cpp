@@ -0,0 +1,122 @@
+#include "detect.hpp"
+
+#include <algorithm>
+#include <climits>
+
+uint64_t mix_key(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+uint64_t cell_key(long pos, char c) {
+  if (c == '#') {
+    return 0;
+  }
+  return mix_key((uint64_t)pos << 8 | (unsigned char)c);
+}
+
+LoopDetector::LoopDetector(const Table& table, const Tape& tape)
+  : tape_key(0),
+    right(1, tape.pos(), std::max(tape.pos(), tape.right_end()), table.num_states),
+    left(-1, tape.pos(), -std::min(tape.pos(), tape.left_end()), table.num_states) {
+  for(long i=tape.left_end(); i<=tape.right_end(); i++) {
+    tape_key ^= cell_key(i, tape.get(i));
+  }
+  saved = snapshot(tape, 0);
+}
+
+uint64_t LoopDetector::key(const Tape& tape, int state) const {
+  return tape_key ^ mix_key((uint64_t)state << 40 ^ (uint64_t)tape.pos());
+}
+
+LoopDetector::Snapshot LoopDetector::snapshot(const Tape& tape, int state) const {
+  Snapshot snapshot { key(tape, state), state, tape.pos(), tape.left_end(), "" };
+  for(long i=snapshot.first; i<=tape.right_end(); i++) {
+    snapshot.cells.push_back(tape.get(i));
+  }
+  return snapshot;
+}
+
+bool LoopDetector::same(const Tape& tape, int state) const {
+  if (state != saved.state || tape.pos() != saved.pos || tape.left_end() != saved.first) {
+    return false;
+  }
+  auto last = tape.right_end();
+  if (last - saved.first + 1 != (long)saved.cells.size()) {
+    return false;
+  }
+  for(long i=saved.first; i<=last; i++) {
+    if (tape.get(i) != saved.cells[i - saved.first]) return false;
+  }
+  return true;
+}
+
+bool LoopDetector::step(const Tape& tape, int state, long written_at, char before, char after) {
+  tape_key ^= cell_key(written_at, before) ^ cell_key(written_at, after);
+
+  /* Brent's algorithm over the configurations */
+  if (key(tape, state) == saved.key && same(tape, state)) {
+    return true;
+  }
+  if (++lambda == power) {
+    saved = snapshot(tape, state);
+    power *= 2;
+    lambda = 0;
+  }
+
+  return right.step(tape, state) || left.step(tape, state);
+}
+
+LoopDetector::Side::Side(int dir, long start, long edge, int num_states)
+  : dir(dir), reach(dir * start), edge(edge), last(num_states) { }
+
+bool LoopDetector::Side::step(const Tape& tape, int state) {
+  long q = dir * tape.pos();
+
+  /* the lowest q since every record with a higher one drops to q */
+  if (!lows.empty() && lows.back().second > q) {
+    auto first = lows.back().first;
+    while (!lows.empty() && lows.back().second >= q) {
+      first = lows.back().first;
+      lows.pop_back();
+    }
+    lows.emplace_back(first, q);
+  }
+
+  if (q <= reach) {
+    return false;
+  }
+  reach = q;
+  if (q <= edge) {
+    return false;
+  }
+
+  auto& record = last[state];
+  if (record.index > 0) {
+    auto segment = std::upper_bound(std::begin(lows), std::end(lows),
+      std::make_pair(record.index, LONG_MAX)) - 1;
+    auto low = segment->second;
+    auto shift = q - record.q;
+    if (record.q - low < window) {
+      bool repeats = true;
+      for(long i=low; i<=record.q && repeats; i++) {
+        repeats = record.cells[i - record.q + window - 1] == tape.get(dir * (i + shift));
+      }
+      if (repeats) {
+        return true;
+      }
+    }
+  }
+
+  /* record indices start at 1, so 0 marks a state without one */
+  record.index = ++count;
+  record.q = q;
+  record.cells.resize(window);
+  for(int i=0; i<window; i++) {
+    record.cells[i] = tape.get(dir * (q - window + 1 + i));
+  }
+  lows.emplace_back(record.index, q);
+  return false;
+}
@@ -0,0 +1,85 @@
+#ifndef _DETECT_H_
+#define _DETECT_H_
+
+#include "machine.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* splitmix64 finalizer */
+uint64_t mix_key(uint64_t x);
+
+/* Zobrist key of one cell; blanks have none so a tape key does not depend
+   on how much of the tape was ever allocated */
+uint64_t cell_key(long pos, char c);
+
+/* Watches a run step by step and proves it never halts.
+
+   Exact cycles: the configuration (state, head position, tape) is hashed
+   incrementally, with a Zobrist key per non-blank cell, and compared
+   against a snapshot retaken at every power of two steps (Brent's
+   algorithm); a hash match is confirmed by comparing the whole snapshot.
+
+   Translated cycles: whenever the head reaches a cell it never visited
+   beyond one end of the tape, the window of cells behind it is kept per
+   state. If the head later breaks the record again in the same state and
+   the cells it visited since the old record hold the same content,
+   shifted, the machine repeats that stretch forever while drifting. */
+class LoopDetector {
+public:
+  /* cells kept behind the head at each record */
+  static const int window = 128;
+
+  LoopDetector(const Table& table, const Tape& tape);
+
+  /* Called after every step with the cell written by it; true once the
+     run is proven to never halt */
+  bool step(const Tape& tape, int state, long written_at, char before, char after);
+
+private:
+  struct Snapshot {
+    uint64_t key;
+    int state;
+    long pos;
+    long first;
+    std::string cells;
+  };
+
+  /* records of one end, in coordinates q growing away from the tape */
+  struct Side {
+    struct Record {
+      uint64_t index = 0;
+      long q;
+      /* cells q-window+1..q at the time of the record */
+      std::string cells;
+    };
+
+    int dir;
+    /* furthest q visited; cells beyond edge were blank at the start */
+    long reach;
+    long edge;
+    uint64_t count = 0;
+    /* last record per state, index 0 when there is none */
+    std::vector<Record> last;
+    /* (first record, lowest q since it) with both increasing, so the lowest
+       q since any record is the entry of its segment */
+    std::vector<std::pair<uint64_t, long>> lows;
+
+    Side(int dir, long start, long edge, int num_states);
+    bool step(const Tape& tape, int state);
+  };
+
+  uint64_t tape_key;
+  Snapshot saved;
+  uint64_t power = 1;
+  uint64_t lambda = 0;
+  Side right;
+  Side left;
+
+  uint64_t key(const Tape& tape, int state) const;
+  Snapshot snapshot(const Tape& tape, int state) const;
+  bool same(const Tape& tape, int state) const;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "machine.hpp"
+#include "detect.hpp"
+#include "profile.hpp"
+
+#include <iterator>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+bool debug_transition = false;
+
+const char alphabets[] = "01#abcdefghijklmnopqrstuvwxyz";
+
+std::ostream& operator<<(std::ostream &os, const Move& move) {
+  switch(move) {
+  case Move::S: os << "S"; break;
+  case Move::R: os << "R"; break;
+  case Move::L: os << "L"; break;
+  }
+  return os;
+}
+
+
+int to_digit(std::string word) {
+  return std::stoi(word);
+}
+
+Move to_move(std::string c) {
+  if (c.compare("S") == 0) { return Move::S; }
+  else if (c.compare("R") == 0) { return Move::R; }
+  else if (c.compare("L") == 0) { return Move::L; }
+  else { assert(false); }
+}
+
+char to_alphabet(std::string word, int count) {
+  assert(word.size() == 1);
+  auto c = word[0];
+  switch(c) {
+  case '0': case '1': case '#': return c;
+  default:
+    assert(c >= 'a' && c <= 'z');
+    assert((c-'a') < count);
+    return c;
+  }
+}
+
+/* Dense index of every alphabet, -1 for other characters */
+struct SymbolIndex {
+  int index[256];
+
+  SymbolIndex() {
+    std::fill(std::begin(index), std::end(index), -1);
+    for(int i=0; alphabets[i] != '\0'; i++) {
+      index[(unsigned char)alphabets[i]] = i;
+    }
+  }
+};
+
+static const SymbolIndex symbol_index;
+
+int to_symbol(char c) {
+  return symbol_index.index[(unsigned char)c];
+}
+
+Transition Transition::read(std::istream& is, int alphabet_count) {
+  std::string a, b, c;
+  is >> a >> b >> c;
+  /* first one is -, then it is infinite loop */
+  if (a.compare("-") == 0) {
+    assert(b.compare("-") == 0 && c.compare("-") == 0);
+    return Transition();
+  }
+  return Transition(to_digit(a),
+                    to_alphabet(b, alphabet_count),
+                    to_move(c));
+}
+
+std::ostream& operator<<(std::ostream &os, const Transition& tr) {
+  if (tr.valid()) {
+    os << tr.state_to() << " " << tr.write_to() << " " << tr.move_to();
+  } else {
+    os << "- - -";
+  }
+  return os;
+}
+
+Table Table::read(std::istream &is) {
+  int K, N;
+  std::string halt_input;
+  is >> K >> N >> halt_input;
+
+  std::vector<Transition> transitions;
+  transitions.reserve(N * (3 + K));
+  for(int i=0; i<N; i++) {
+    for(int i=0; i < 3 + K; i++) {
+      transitions.push_back(Transition::read(is, K));
+    }
+  }
+  std::vector<bool> halt;
+  std::transform(std::begin(halt_input), std::end(halt_input),
+    std::back_inserter(halt), [&](auto c) {
+      switch(c) {
+      case '0': return false;
+      case '1': return true;
+      default: assert(false);
+      }
+    });
+  assert((int)halt.size() == N);
+  return Table(K, N, std::move(transitions), std::move(halt));
+}
+
+std::ostream& operator<<(std::ostream &os, const Table& table) {
+  os << table.K << '\n';
+  os << table.num_states << '\n';
+  for(bool h: table.halt) {
+    os << h;
+  }
+  os << '\n';
+  bool first = true;
+  for(auto& tr: table.transitions) {
+    if (first) { first = false; }
+    else {
+      os << '\n';
+    }
+    os << tr;
+  }
+  return os;
+}
+
+Tape::Tape(std::string input)
+  : cells(input.size() + 64, '#'), origin(32) {
+  std::copy(std::begin(input), std::end(input), std::begin(cells) + origin);
+  head = &cells[origin - 1];
+}
+
+Tape::Tape(const Tape& other)
+  : cells(other.cells), origin(other.origin),
+    head(cells.data() + (other.head - other.cells.data())) {}
+
+Tape& Tape::operator=(const Tape& other) {
+  auto offset = other.head - other.cells.data();
+  cells = other.cells;
+  origin = other.origin;
+  head = cells.data() + offset;
+  return *this;
+}
+
+void Tape::grow() {
+  auto offset = head - cells.data();
+  auto margin = (long)cells.size() / 2 + 1;
+  std::vector<char> grown(cells.size() + 2 * margin, '#');
+  std::copy(std::begin(cells), std::end(cells), std::begin(grown) + margin);
+  cells.swap(grown);
+  origin += margin;
+  head = cells.data() + offset + margin;
+}
+
+long Tape::left_end() const {
+  for(size_t i=0; i<cells.size(); i++) {
+    if (cells[i] != '#') return (long)i - origin;
+  }
+  return pos();
+}
+
+long Tape::right_end() const {
+  for(size_t i=cells.size(); i-- > 0;) {
+    if (cells[i] != '#') return (long)i - origin;
+  }
+  return pos();
+}
+
+std::string Tape::as_string() const {
+  auto first = std::find_if(std::begin(cells), std::end(cells), [](char c) { return c != '#'; });
+  if (first == std::end(cells)) {
+    return "#";
+  }
+  auto last = std::find_if(cells.rbegin(), cells.rend(), [](char c) { return c != '#'; }).base();
+  return std::string(first, last);
+}
+
+std::ostream& operator<<(std::ostream& os, const Tape& tape) {
+  auto pos = tape.pos();
+  auto left_end = tape.left_end();
+  auto right_end = tape.right_end();
+  for(long i=std::min(pos, left_end); i<= std::max(pos, right_end); i++) {
+    if (i == left_end && i == right_end) {
+      os << "x";
+    } else if (i == left_end) {
+      os << "l";
+    } else if (i == right_end) {
+      os << "r";
+    } else {
+      os << " ";
+    }
+  }
+  os << '\n';
+  for(long i=std::min(pos, left_end); i<= std::max(pos, right_end); i++) {
+    os << tape.get(i);
+  }
+  os << '\n';
+
+  for(long i=std::min(pos, left_end); i<= std::max(pos, right_end); i++) {
+    if (i == pos) {
+      os << "^";
+    } else {
+      os << " ";
+    }
+  }
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const Outcome& outcome) {
+  switch(outcome) {
+  case Outcome::Halted: os << "halted"; break;
+  case Outcome::Undefined: os << "undefined"; break;
+  case Outcome::Timeout: os << "timeout"; break;
+  case Outcome::Loop: os << "loop"; break;
+  }
+  return os;
+}
+
+/* the stepping loop of run(); the plain instance does no detector or
+   profiler work */
+template <bool detect, bool observe>
+static Execution run_steps(const Table& table, Tape tape, const Limits& limits,
+                           int state, uint64_t steps) {
+  std::unique_ptr<LoopDetector> detector;
+  if (detect) {
+    detector.reset(new LoopDetector(table, tape));
+  }
+
+  while (table.is_halted(state) == false) {
+    if (steps == limits.steps) {
+      return Execution { Outcome::Timeout, std::move(tape), steps, state };
+    }
+
+    /* read tape */
+    auto read = tape.read();
+
+    /* read transitioon table */
+    auto transition = table.get_transition(state, read);
+    if (transition.valid() == false) {
+      return Execution { Outcome::Undefined, std::move(tape), steps, state };
+    }
+
+    if (observe) {
+      if (limits.profile && limits.profile->sampled(steps)) {
+        limits.profile->record(steps, state, to_symbol(read), tape.pos());
+      }
+      if (limits.trace) limits.trace->record(steps, tape.pos(), state, read, transition);
+    }
+
+    /* write it, move header, update state */
+    auto written_at = detect ? tape.pos() : 0;
+    tape.write(transition.write_to());
+    tape.move(transition.move_to());
+    state = transition.state_to();
+    steps++;
+
+    if (detect && detector->step(tape, state, written_at, read, transition.write_to())) {
+      return Execution { Outcome::Loop, std::move(tape), steps, state };
+    }
+
+    if (debug_transition) {
+      std::cout << transition << '\n';
+      std::cout << tape << '\n';
+    }
+    if (tape.cells.size() > limits.cells) {
+      return Execution { Outcome::Timeout, std::move(tape), steps, state };
+    }
+  }
+  /* return final state tape */
+  return Execution { Outcome::Halted, std::move(tape), steps, state };
+}
+
+Execution run(const Table& table, Tape tape, const Limits& limits,
+              int state, uint64_t steps) {
+  if (debug_transition && steps == 0) {
+    std::cout << tape << '\n';
+  }
+  bool observe = limits.profile || limits.trace;
+  if (limits.detect_loops) {
+    return observe ? run_steps<true, true>(table, std::move(tape), limits, state, steps)
+                   : run_steps<true, false>(table, std::move(tape), limits, state, steps);
+  }
+  return observe ? run_steps<false, true>(table, std::move(tape), limits, state, steps)
+                 : run_steps<false, false>(table, std::move(tape), limits, state, steps);
+}
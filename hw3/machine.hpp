@@ -0,0 +1,190 @@
+#ifndef _MACHINE_H_
+#define _MACHINE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+/* Enable to print the intermediate transition */
+extern bool debug_transition;
+
+/* Possible alphabets */
+extern const char alphabets[];
+
+/* Possible movements */
+enum class Move {
+  S, R, L
+};
+
+std::ostream& operator<<(std::ostream &os, const Move& move);
+
+int to_digit(std::string word);
+Move to_move(std::string c);
+char to_alphabet(std::string word, int count);
+
+/* Dense index of an alphabet, -1 for other characters */
+int to_symbol(char c);
+
+/* One transition packed in 32 bits:
+   bit 0 valid, bits 1-2 move, bits 3-7 written symbol, bits 8-31 next state */
+struct Transition {
+  uint32_t bits;
+
+  Transition(): bits(0) {}
+  Transition(int state_to, char change_to, Move move_to)
+    : bits(1 | (uint32_t)move_to << 1 | (uint32_t)to_symbol(change_to) << 3
+           | (uint32_t)state_to << 8)
+  {
+    assert(to_symbol(change_to) >= 0 && state_to < (1 << 24));
+  }
+
+  bool valid() const { return bits & 1; }
+  int state_to() const { return bits >> 8; }
+  int write_symbol() const { return (bits >> 3) & 31; }
+  char write_to() const { return alphabets[write_symbol()]; }
+  Move move_to() const { return (Move)((bits >> 1) & 3); }
+
+  static Transition read(std::istream& is, int alphabet_count);
+};
+
+std::ostream& operator<<(std::ostream &os, const Transition& tr);
+
+/* Transitions of every state in one flat array, row `state` holding one
+   entry per alphabet 0, 1, #, a, b, ... */
+struct Table {
+  int K;
+  int num_states;
+  int num_symbols;
+  std::vector<Transition> transitions;
+  std::vector<bool> halt;
+
+  Table(int K, int num_states, std::vector<Transition> transitions, std::vector<bool> halt)
+    : K(K), num_states(num_states), num_symbols(3 + K),
+      transitions(std::move(transitions)), halt(std::move(halt)) { }
+
+  static Table read(std::istream &is);
+
+  /* symbol is a dense alphabet index */
+  Transition get(int state, int symbol) const {
+    return transitions[state * num_symbols + symbol];
+  }
+
+  Transition get_transition(int state, char a) const {
+    auto symbol = to_symbol(a);
+    if (symbol < 0 || symbol >= num_symbols) {
+      return Transition();
+    }
+    return get(state, symbol);
+  }
+
+  bool is_halted(int state) const {
+    return halt[state];
+  }
+};
+
+std::ostream& operator<<(std::ostream &os, const Table& table);
+
+/* Tape cells in one buffer that grows in both directions, blanks stored
+   as '#'. The head is a pointer into the buffer; the written extent is
+   only computed when the tape is printed. */
+struct Tape {
+  std::vector<char> cells;
+  /* index of position 0 in cells */
+  long origin;
+  char* head;
+
+  Tape(std::string input);
+  Tape(const Tape& other);
+  /* moving keeps the buffer, so head stays valid */
+  Tape(Tape&&) = default;
+  Tape& operator=(Tape&&) = default;
+  Tape& operator=(const Tape& other);
+
+  long pos() const {
+    return head - cells.data() - origin;
+  }
+
+  char get(long i) const {
+    auto at = origin + i;
+    if (at < 0 || at >= (long)cells.size()) {
+      return '#';
+    }
+    return cells[at];
+  }
+
+  char read() const {
+    return *head;
+  }
+
+  void write(char c) {
+    *head = c;
+  }
+
+  void move(Move dir) {
+    switch(dir) {
+    case Move::S: return;
+    case Move::L:
+      if (head == cells.data()) grow();
+      head--;
+      return;
+    case Move::R:
+      if (head == cells.data() + cells.size() - 1) grow();
+      head++;
+      return;
+    }
+  }
+
+  /* doubles the buffer, keeping the old cells in the middle */
+  void grow();
+
+  /* positions of the first and last non-blank cells; both are the head
+     position when the tape is blank */
+  long left_end() const;
+  long right_end() const;
+
+  /* non-blank extent of the tape, "#" if it is blank */
+  std::string as_string() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const Tape& tape);
+
+/* How a run ended; Timeout covers running out of either budget and Loop
+   a run proven to never halt */
+enum class Outcome {
+  Halted, Undefined, Timeout, Loop
+};
+
+std::ostream& operator<<(std::ostream& os, const Outcome& outcome);
+
+class Profile;
+class Trace;
+
+/* Budgets of a run: base machine steps and tape buffer cells. The buffer
+   starts at the input plus 64 cells and grows by doubling. */
+struct Limits {
+  uint64_t steps = UINT64_MAX;
+  size_t cells = SIZE_MAX;
+  /* watch for cycles with a LoopDetector */
+  bool detect_loops = false;
+  /* count every step into these when set, see profile.hpp */
+  Profile* profile = nullptr;
+  Trace* trace = nullptr;
+};
+
+struct Execution {
+  Outcome outcome;
+  /* the tape and state when the run stopped */
+  Tape tape;
+  uint64_t steps;
+  int state;
+};
+
+/* Runs until a halting state, an undefined transition, the end of a
+   budget or a detected loop. A run picked up later starts from the state
+   and step count it stopped at; the step budget counts them all. */
+Execution run(const Table& table, Tape tape, const Limits& limits = Limits(),
+              int state = 0, uint64_t steps = 0);
+
+#endif
@@ -0,0 +1,149 @@
+#include "macro.hpp"
+
+#include <set>
+#include <tuple>
+#include <algorithm>
+#include <cstdlib>
+
+MacroMachine::MacroMachine(const Table& table, int block_size)
+  : table(table), k(block_size), blank(0) {
+  assert(k >= 1 && k <= max_block_size);
+  for(int i=0; i<k; i++) {
+    blank = with_symbol(blank, i, to_symbol('#'));
+  }
+}
+
+MacroMachine::Result MacroMachine::simulate(int state, Block block, bool from_right) const {
+  int offset = from_right ? k - 1 : 0;
+  uint64_t steps = 0;
+  /* configurations seen once the block takes suspiciously long */
+  std::set<std::tuple<Block, int, int>> seen;
+  for(;;) {
+    if (table.is_halted(state)) {
+      return Result { Kind::Halt, false, offset, state, block, steps };
+    }
+    auto read = symbol(block, offset);
+    auto transition = read < table.num_symbols ? table.get(state, read) : Transition();
+    if (transition.valid() == false) {
+      return Result { Kind::Undefined, false, offset, state, block, steps };
+    }
+    block = with_symbol(block, offset, transition.write_symbol());
+    state = transition.state_to();
+    steps++;
+    switch(transition.move_to()) {
+    case Move::S: break;
+    case Move::L: offset--; break;
+    case Move::R: offset++; break;
+    }
+    if (offset < 0 || offset >= k) {
+      return Result { Kind::Exit, offset >= k, 0, state, block, steps };
+    }
+    if (steps > 1024 && !seen.insert(std::make_tuple(block, state, offset)).second) {
+      return Result { Kind::Loop, false, offset, state, block, steps };
+    }
+  }
+}
+
+const MacroMachine::Result& MacroMachine::step(int state, Block block, bool from_right) {
+  Key key { block, (uint32_t)state << 1 | from_right };
+  auto it = cache.find(key);
+  if (it == cache.end()) {
+    it = cache.emplace(key, simulate(state, block, from_right)).first;
+  }
+  return it->second;
+}
+
+Execution MacroMachine::run(const std::string& input, const Limits& limits) {
+  /* characters outside the alphabets do not fit a block */
+  if (std::any_of(std::begin(input), std::end(input), [](char c) { return to_symbol(c) < 0; })) {
+    return ::run(table, Tape(input), limits);
+  }
+
+  steps = 0;
+  RunStack<Block> left(blank), right(blank);
+  std::vector<Block> blocks;
+  for(size_t i=0; i<input.size(); i+=k) {
+    auto block = blank;
+    for(size_t j=0; j<(size_t)k && i + j < input.size(); j++) {
+      block = with_symbol(block, j, to_symbol(input[i + j]));
+    }
+    blocks.push_back(block);
+  }
+  for(auto it=blocks.rbegin(); it!=blocks.rend(); it++) {
+    right.push(*it, 1);
+  }
+
+  /* the head starts on position -1, the right edge of the blank block on
+     top of the left stack */
+  bool facing_right = false;
+  int state = 0;
+
+  auto stop = [&](Outcome outcome) {
+    std::string tape;
+    auto append = [&](const RunStack<Block>::Run& run) {
+      for(uint64_t n=0; n<run.count; n++) {
+        for(int i=0; i<k; i++) {
+          tape.push_back(alphabets[symbol(run.symbol, i)]);
+        }
+      }
+    };
+    for(auto& run: left.all()) append(run);
+    for(auto it=right.all().rbegin(); it!=right.all().rend(); it++) append(*it);
+
+    auto first = tape.find_first_not_of('#');
+    if (first == std::string::npos) {
+      tape.clear();
+    } else {
+      tape = tape.substr(first, tape.find_last_not_of('#') - first + 1);
+    }
+    return Execution { outcome, Tape(tape), steps, state };
+  };
+
+  for(;;) {
+    auto& from = facing_right ? right : left;
+    auto& to = facing_right ? left : right;
+    auto block = from.top();
+    auto result = step(state, block, !facing_right);
+
+    if (result.kind == Kind::Loop) {
+      return stop(Outcome::Loop);
+    }
+    if (result.steps > limits.steps - steps) {
+      return stop(Outcome::Timeout);
+    }
+    if (result.kind == Kind::Halt || result.kind == Kind::Undefined) {
+      steps += result.steps;
+      state = result.state;
+      from.take(1);
+      from.push(result.block, 1);
+      return stop(result.kind == Kind::Halt ? Outcome::Halted : Outcome::Undefined);
+    }
+
+    auto forward = result.right == facing_right;
+    if (forward && result.state == state) {
+      /* every block of the run is crossed the same way */
+      if (from.empty()) {
+        /* sweeping into the blank tape forever */
+        return stop(Outcome::Loop);
+      }
+      auto count = from.top_count();
+      if (count * result.steps > limits.steps - steps) {
+        return stop(Outcome::Timeout);
+      }
+      from.take(count);
+      to.push(result.block, count);
+      steps += count * result.steps;
+    } else {
+      from.take(1);
+      (result.right ? left : right).push(result.block, 1);
+      facing_right = result.right;
+      steps += result.steps;
+    }
+    state = result.state;
+
+    /* the blocks on both stacks and the one the head faces */
+    if ((left.length() + right.length() + 1) * k > limits.cells) {
+      return stop(Outcome::Timeout);
+    }
+  }
+}
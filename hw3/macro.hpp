@@ -0,0 +1,82 @@
+#ifndef _MACRO_H_
+#define _MACRO_H_
+
+#include "machine.hpp"
+#include "runtape.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/* Macro-machine simulation. The tape is cut into blocks of k cells, each
+   block a single super-symbol, and kept as run-length encoded stacks on
+   both sides of the head. Running the base machine through one block from
+   one of its edges is computed once per (state, block, edge) and cached;
+   when the head would pass through a run of equal blocks in the same state
+   the whole run is crossed in one step. */
+class MacroMachine {
+public:
+  /* blocks pack 5-bit alphabet indices, so k is at most 12 */
+  static const int max_block_size = 12;
+
+  MacroMachine(const Table& table, int block_size);
+
+  /* Runs like run() on the input. A cycle inside a block or an endless
+     sweep into blank tape ends as Loop even without detect_loops; the
+     step budget is checked between macro steps, the cell budget against
+     the cells of the blocks kept on the stacks, and the
+     returned tape keeps the cells but not the head position. */
+  Execution run(const std::string& input, const Limits& limits = Limits());
+
+  /* base machine steps taken by the last run() */
+  uint64_t steps = 0;
+  size_t cache_size() const { return cache.size(); }
+
+private:
+  using Block = uint64_t;
+
+  enum class Kind : uint8_t { Exit, Halt, Undefined, Loop };
+
+  /* running the base machine through a block from one of its edges */
+  struct Result {
+    Kind kind;
+    /* the head left through the right edge; for Halt the offset in the block */
+    bool right;
+    int offset;
+    int state;
+    Block block;
+    uint64_t steps;
+  };
+
+  struct Key {
+    Block block;
+    uint32_t state_edge;
+    bool operator==(const Key& other) const {
+      return block == other.block && state_edge == other.state_edge;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return key.block * 0x9e3779b97f4a7c15ull ^ key.state_edge;
+    }
+  };
+
+  const Table& table;
+  int k;
+  Block blank;
+  std::unordered_map<Key, Result, KeyHash> cache;
+
+  int symbol(Block block, int offset) const {
+    return (block >> (5 * offset)) & 31;
+  }
+  Block with_symbol(Block block, int offset, int symbol) const {
+    return (block & ~((Block)31 << (5 * offset))) | (Block)symbol << (5 * offset);
+  }
+
+  const Result& step(int state, Block block, bool from_right);
+  Result simulate(int state, Block block, bool from_right) const;
+};
+
+#endif
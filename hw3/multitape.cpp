@@ -0,0 +1,198 @@
+#include "multitape.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <cctype>
+#include <climits>
+
+std::string next_word(std::istream& is) {
+  std::string word;
+  if (!(is >> word)) {
+    throw table_error("unexpected end of the table");
+  }
+  return word;
+}
+
+int parse_number(const std::string& word, int low, int high, const char* what) {
+  if (word.empty() || word.size() > 9
+      || !std::all_of(std::begin(word), std::end(word),
+                      [](char c) { return std::isdigit((unsigned char)c); })) {
+    throw table_error(std::string("expected ") + what + ": " + word);
+  }
+  auto value = std::stoi(word);
+  if (value < low || value > high) {
+    throw table_error(std::string(what) + " out of range: " + word);
+  }
+  return value;
+}
+
+uint8_t parse_symbol(const std::string& word, int num_symbols) {
+  auto symbol = word.size() == 1 ? to_symbol(word[0]) : -1;
+  if (symbol < 0 || symbol >= num_symbols) {
+    throw table_error("not a symbol of the table: " + word);
+  }
+  return symbol;
+}
+
+Move parse_move(const std::string& word) {
+  if (word.compare("S") == 0) return Move::S;
+  if (word.compare("R") == 0) return Move::R;
+  if (word.compare("L") == 0) return Move::L;
+  throw table_error("not a move: " + word);
+}
+
+MultiTable MultiTable::read(std::istream& is) {
+  MultiTable table;
+  if (next_word(is).compare("T") != 0) {
+    throw table_error("expected the T header");
+  }
+  table.tapes = parse_number(next_word(is), 1, 24, "the number of tapes");
+  /* the layout word is optional, so look for it on the header line */
+  std::string layout;
+  std::getline(is, layout);
+  layout.erase(std::remove_if(std::begin(layout), std::end(layout),
+                              [](char c) { return std::isspace((unsigned char)c); }),
+               std::end(layout));
+  if (!layout.empty() && layout.compare("tracks") != 0) {
+    throw table_error("expected tracks or the end of the header: " + layout);
+  }
+  table.tracks = layout.compare("tracks") == 0;
+
+  table.K = parse_number(next_word(is), 0, 26, "K");
+  table.num_states = parse_number(next_word(is), 1, (1 << 24) - 1, "the number of states");
+  auto halt_input = next_word(is);
+  table.num_symbols = 3 + table.K;
+  table.combinations = 1;
+  for(int i=0; i<table.tapes; i++) {
+    table.combinations *= table.num_symbols;
+    if (table.combinations > (1 << 24)) {
+      throw table_error("too many symbol combinations");
+    }
+  }
+  if ((size_t)table.num_states * table.combinations > (1u << 28)) {
+    throw table_error("too many transitions");
+  }
+
+  auto num_moves = table.tracks ? 1 : table.tapes;
+  auto entries = (size_t)table.num_states * table.combinations;
+  table.next.reserve(entries);
+  table.writes.reserve(entries * table.tapes);
+  table.moves.reserve(entries * table.tapes);
+  for(size_t e=0; e<entries; e++) {
+    auto next = next_word(is);
+    /* first one is -, then it is infinite loop */
+    if (next.compare("-") == 0) {
+      for(int i=0; i<table.tapes + num_moves; i++) {
+        if (next_word(is).compare("-") != 0) {
+          throw table_error("an undefined transition must be all -");
+        }
+      }
+      table.next.push_back(-1);
+      table.writes.insert(std::end(table.writes), table.tapes, 0);
+      table.moves.insert(std::end(table.moves), table.tapes, Move::S);
+      continue;
+    }
+    table.next.push_back(parse_number(next, 0, table.num_states - 1, "a state"));
+    for(int i=0; i<table.tapes; i++) {
+      table.writes.push_back(parse_symbol(next_word(is), table.num_symbols));
+    }
+    for(int i=0; i<num_moves; i++) {
+      table.moves.push_back(parse_move(next_word(is)));
+    }
+    /* tracks move together */
+    table.moves.insert(std::end(table.moves), table.tapes - num_moves, table.moves.back());
+  }
+
+  for(auto c: halt_input) {
+    if (c != '0' && c != '1') {
+      throw table_error("halting states must be 0 or 1: " + halt_input);
+    }
+    table.halt.push_back(c == '1');
+  }
+  if ((int)table.halt.size() != table.num_states) {
+    throw table_error("expected one halting flag per state: " + halt_input);
+  }
+  return table;
+}
+
+MultiTape::MultiTape(int count, const std::string& input, bool tracks)
+  : count(count), tracks(tracks), cells(count), origins(count, 32), heads(count, 31) {
+  for(int i=0; i<count; i++) {
+    cells[i].assign(i == 0 || tracks ? input.size() + 64 : 64, '#');
+  }
+  std::copy(std::begin(input), std::end(input), std::begin(cells[0]) + 32);
+}
+
+void MultiTape::grow(int i) {
+  auto margin = (long)cells[i].size() / 2 + 1;
+  std::vector<char> grown(cells[i].size() + 2 * margin, '#');
+  std::copy(std::begin(cells[i]), std::end(cells[i]), std::begin(grown) + margin);
+  cells[i].swap(grown);
+  origins[i] += margin;
+  heads[i] += margin;
+}
+
+void MultiTape::grow_tracks() {
+  for(int i=0; i<count; i++) {
+    grow(i);
+  }
+}
+
+size_t MultiTape::size() const {
+  size_t size = 0;
+  for(auto& tape: cells) size += tape.size();
+  return size;
+}
+
+std::string MultiTape::as_string(int i) const {
+  auto written = [](char c) { return c != '#'; };
+  /* [first, last) over the tapes that are cut together */
+  long first = LONG_MAX, last = LONG_MIN;
+  for(int j=0; j<count; j++) {
+    if (j != i && !tracks) continue;
+    auto& tape = cells[j];
+    auto begin = std::find_if(std::begin(tape), std::end(tape), written);
+    if (begin == std::end(tape)) continue;
+    auto end = std::find_if(tape.rbegin(), tape.rend(), written).base();
+    first = std::min(first, (long)(begin - std::begin(tape)));
+    last = std::max(last, (long)(end - std::begin(tape)));
+  }
+  if (first > last) {
+    return "#";
+  }
+  return std::string(std::begin(cells[i]) + first, std::begin(cells[i]) + last);
+}
+
+MultiExecution run(const MultiTable& table, MultiTape tapes, const Limits& limits) {
+  assert(tapes.count == table.tapes && tapes.tracks == table.tracks);
+  auto count = tapes.count;
+  int state = 0;
+  uint64_t steps = 0;
+  while (table.halt[state] == false) {
+    if (steps == limits.steps) {
+      return MultiExecution { Outcome::Timeout, std::move(tapes), steps, state };
+    }
+
+    /* read every head and look the combination up */
+    auto combination = tapes.combination(table.num_symbols);
+    auto at = table.index(state, std::max(combination, 0));
+    if (combination < 0 || table.next[at] < 0) {
+      return MultiExecution { Outcome::Undefined, std::move(tapes), steps, state };
+    }
+
+    /* write them, move headers, update state */
+    auto entry = at * count;
+    for(int i=0; i<count; i++) {
+      tapes.cells[i][tapes.heads[i]] = alphabets[table.writes[entry + i]];
+      if (!table.tracks) tapes.move(i, table.moves[entry + i]);
+    }
+    if (table.tracks) tapes.move_tracks(table.moves[entry]);
+    state = table.next[at];
+    steps++;
+
+    if (limits.cells != SIZE_MAX && tapes.size() > limits.cells) {
+      return MultiExecution { Outcome::Timeout, std::move(tapes), steps, state };
+    }
+  }
+  return MultiExecution { Outcome::Halted, std::move(tapes), steps, state };
+}
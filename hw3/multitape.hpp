@@ -0,0 +1,139 @@
+#ifndef _MULTITAPE_H_
+#define _MULTITAPE_H_
+
+#include "machine.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* Machines over k tapes. A table starts with a header line
+     T k          k tapes, each with its own head
+     T k tracks   k tracks under a single head
+   followed by K, the number of states and the halting states as for a
+   single tape. Every state then has one line per combination of the
+   symbols under the heads, in the order 00..0, 00..1, 00..#, ... with
+   tape 0 varying slowest; a line is the next state, the k symbols to
+   write and the k moves (one move for tracks), or all "-". */
+
+/* a malformed "T" or "N" table */
+class table_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/* Word readers of the table formats; all of them throw table_error.
+   next_word fails at the end of the input, parse_number takes a decimal
+   in [low, high] and what names it in the message. */
+std::string next_word(std::istream& is);
+int parse_number(const std::string& word, int low, int high, const char* what);
+uint8_t parse_symbol(const std::string& word, int num_symbols);
+Move parse_move(const std::string& word);
+
+struct MultiTable {
+  int tapes;
+  bool tracks;
+  int K;
+  int num_states;
+  int num_symbols;
+  /* num_symbols ^ tapes */
+  int combinations;
+  /* per (state, combination): next state or -1 when undefined */
+  std::vector<int32_t> next;
+  /* per (state, combination, tape): symbol index to write, and move */
+  std::vector<uint8_t> writes;
+  std::vector<Move> moves;
+  std::vector<bool> halt;
+
+  /* reads from the "T" header on; throws table_error */
+  static MultiTable read(std::istream& is);
+
+  size_t index(int state, int combination) const {
+    return (size_t)state * combinations + combination;
+  }
+};
+
+/* k tapes laid out as parallel arrays, so a step reads every head from
+   one array of positions; each tape grows on its own like Tape. Tracks
+   are tapes of the same size under one head: they grow together and
+   every entry of heads and origins stays equal. */
+struct MultiTape {
+  int count;
+  bool tracks;
+  std::vector<std::vector<char>> cells;
+  /* index of position 0 in cells[i] */
+  std::vector<long> origins;
+  /* index of the head in cells[i] */
+  std::vector<long> heads;
+
+  /* the input on tape 0 from position 0, every head on position -1 */
+  MultiTape(int count, const std::string& input, bool tracks = false);
+
+  /* combined index of the symbols under the heads, -1 when one of them
+     is outside the table's alphabets */
+  int combination(int num_symbols) const {
+    int combination = 0;
+    for(int i=0; i<count; i++) {
+      auto symbol = to_symbol(cells[i][heads[i]]);
+      if (symbol < 0 || symbol >= num_symbols) {
+        return -1;
+      }
+      combination = combination * num_symbols + symbol;
+    }
+    return combination;
+  }
+
+  void move(int i, Move dir) {
+    switch(dir) {
+    case Move::S: return;
+    case Move::L:
+      if (heads[i] == 0) grow(i);
+      heads[i]--;
+      return;
+    case Move::R:
+      if (heads[i] == (long)cells[i].size() - 1) grow(i);
+      heads[i]++;
+      return;
+    }
+  }
+
+  /* moves the single head of tracks */
+  void move_tracks(Move dir) {
+    switch(dir) {
+    case Move::S: return;
+    case Move::L:
+      if (heads[0] == 0) grow_tracks();
+      break;
+    case Move::R:
+      if (heads[0] == (long)cells[0].size() - 1) grow_tracks();
+      break;
+    }
+    for(auto& head: heads) {
+      head += dir == Move::L ? -1 : 1;
+    }
+  }
+
+  void grow(int i);
+  void grow_tracks();
+  size_t size() const;
+
+  /* non-blank extent of tape i, "#" if it is blank; tracks are all cut
+     to the extent of the non-blank cells of any track, so cells under
+     each other stay under each other */
+  std::string as_string(int i) const;
+};
+
+struct MultiExecution {
+  Outcome outcome;
+  MultiTape tapes;
+  uint64_t steps;
+  int state;
+};
+
+/* run() for k tapes; the cell budget counts all tape buffers, loop
+   detection, profiles and traces are not supported */
+MultiExecution run(const MultiTable& table, MultiTape tapes, const Limits& limits = Limits());
+
+#endif
@@ -0,0 +1,245 @@
+#include "ntm.hpp"
+#include "detect.hpp"
+#include "multitape.hpp"
+
+#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+
+NondeterministicTable NondeterministicTable::read(std::istream& is) {
+  NondeterministicTable table;
+  if (next_word(is).compare("N") != 0) {
+    throw table_error("expected the N header");
+  }
+  table.K = parse_number(next_word(is), 0, 26, "K");
+  table.num_states = parse_number(next_word(is), 1, (1 << 24) - 1, "the number of states");
+  auto halt_input = next_word(is);
+  table.num_symbols = 3 + table.K;
+  std::string line;
+  std::getline(is, line);
+
+  for(int i=0; i<table.num_states * table.num_symbols;) {
+    if (!std::getline(is, line)) {
+      throw table_error("unexpected end of the table");
+    }
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    table.first.push_back(table.choices.size());
+    std::istringstream choices { line };
+    for(std::string choice; std::getline(choices, choice, '|');) {
+      std::istringstream stream { choice };
+      std::vector<std::string> words { std::istream_iterator<std::string>(stream),
+                                       std::istream_iterator<std::string>() };
+      if (words.size() != 3) {
+        throw table_error("a transition is: state write move, or - - -: " + choice);
+      }
+      /* first one is -, then it is infinite loop */
+      if (words[0].compare("-") == 0) {
+        if (words[1].compare("-") != 0 || words[2].compare("-") != 0) {
+          throw table_error("an undefined transition must be all -");
+        }
+        continue;
+      }
+      table.choices.push_back(Transition(
+        parse_number(words[0], 0, table.num_states - 1, "a state"),
+        alphabets[parse_symbol(words[1], table.num_symbols)],
+        parse_move(words[2])));
+    }
+    i++;
+  }
+  table.first.push_back(table.choices.size());
+
+  for(auto c: halt_input) {
+    if (c != '0' && c != '1') {
+      throw table_error("halting states must be 0 or 1: " + halt_input);
+    }
+    table.halt.push_back(c == '1');
+  }
+  if ((int)table.halt.size() != table.num_states) {
+    throw table_error("expected one halting flag per state: " + halt_input);
+  }
+  return table;
+}
+
+PagedTape::PagedTape(const std::string& input)
+  : first_page(0), head(-1), content_key(0) {
+  for(long i=0; i<(long)input.size(); i++) {
+    auto at = head;
+    head = i;
+    write(input[i]);
+    head = at;
+  }
+}
+
+long PagedTape::page_of(long pos) {
+  return pos >= 0 ? pos / page_size : -((-pos - 1) / page_size) - 1;
+}
+
+const PagedTape::Page* PagedTape::page(long number) const {
+  auto at = number - first_page;
+  if (at < 0 || at >= (long)pages.size()) {
+    return nullptr;
+  }
+  return pages[at].get();
+}
+
+char PagedTape::read() const {
+  auto number = page_of(head);
+  auto cells = page(number);
+  return cells ? (*cells)[head - number * page_size] : '#';
+}
+
+void PagedTape::write(char c) {
+  auto before = read();
+  if (before == c) {
+    return;
+  }
+  content_key ^= cell_key(head, before) ^ cell_key(head, c);
+
+  auto number = page_of(head);
+  if (pages.empty()) {
+    first_page = number;
+  }
+  if (number < first_page) {
+    pages.insert(std::begin(pages), first_page - number, nullptr);
+    first_page = number;
+  }
+  if (number - first_page >= (long)pages.size()) {
+    pages.resize(number - first_page + 1);
+  }
+  auto& cells = pages[number - first_page];
+  if (!cells) {
+    cells = std::make_shared<Page>();
+    cells->fill('#');
+  } else if (cells.use_count() > 1) {
+    cells = std::make_shared<Page>(*cells);
+  }
+  (*cells)[head - number * page_size] = c;
+}
+
+void PagedTape::move(Move dir) {
+  switch(dir) {
+  case Move::S: return;
+  case Move::L: head--; return;
+  case Move::R: head++; return;
+  }
+}
+
+bool PagedTape::same_cells(const PagedTape& other) const {
+  static const Page blank = [] { Page page; page.fill('#'); return page; }();
+  auto low = std::min(first_page, other.first_page);
+  auto high = std::max(first_page + (long)pages.size(), other.first_page + (long)other.pages.size());
+  for(long number=low; number<high; number++) {
+    auto a = page(number);
+    auto b = other.page(number);
+    if (a == b) {
+      continue;
+    }
+    if (*(a ? a : &blank) != *(b ? b : &blank)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string PagedTape::as_string() const {
+  std::string cells;
+  for(auto& page: pages) {
+    if (page) cells.append(std::begin(*page), std::end(*page));
+    else cells.append(page_size, '#');
+  }
+  auto first = cells.find_first_not_of('#');
+  if (first == std::string::npos) {
+    return "#";
+  }
+  return cells.substr(first, cells.find_last_not_of('#') - first + 1);
+}
+
+namespace {
+
+struct Configuration {
+  int state;
+  PagedTape tape;
+
+  bool operator==(const Configuration& other) const {
+    return state == other.state && tape.pos() == other.tape.pos()
+      && tape.key() == other.tape.key() && tape.same_cells(other.tape);
+  }
+};
+
+struct ConfigurationHash {
+  size_t operator()(const Configuration& configuration) const {
+    return configuration.tape.key()
+      ^ mix_key((uint64_t)configuration.state << 40 ^ (uint64_t)configuration.tape.pos());
+  }
+};
+
+}
+
+NondeterministicExecution explore(const NondeterministicTable& table, const std::string& input,
+                                  const Limits& limits, size_t max_configurations) {
+  /* every configuration kept maps to the depth it was found at; the
+     frontier points into seen, so a branch shares every page with its
+     parent until it writes */
+  std::unordered_map<Configuration, uint64_t, ConfigurationHash> seen;
+  std::vector<const Configuration*> frontier {
+    &seen.emplace(Configuration { 0, PagedTape(input) }, 0).first->first
+  };
+  size_t configurations = 1;
+  bool died = false;
+
+  uint64_t depth = 0;
+  for(; !frontier.empty(); depth++) {
+    for(auto configuration: frontier) {
+      if (table.halt[configuration->state]) {
+        return NondeterministicExecution {
+          Outcome::Halted, configuration->tape.as_string(), depth, configurations
+        };
+      }
+    }
+    if (depth == limits.steps) {
+      return NondeterministicExecution { Outcome::Timeout, "", depth, configurations };
+    }
+
+    std::vector<const Configuration*> next;
+    for(auto configuration: frontier) {
+      auto symbol = to_symbol(configuration->tape.read());
+      if (symbol < 0 || symbol >= table.num_symbols) {
+        died = true;
+        continue;
+      }
+      auto entry = configuration->state * table.num_symbols + symbol;
+      if (table.first[entry] == table.first[entry + 1]) {
+        died = true;
+      }
+      for(auto i=table.first[entry]; i<table.first[entry + 1]; i++) {
+        auto& transition = table.choices[i];
+        Configuration branch { transition.state_to(), configuration->tape };
+        branch.tape.write(transition.write_to());
+        branch.tape.move(transition.move_to());
+        auto inserted = seen.emplace(std::move(branch), depth + 1);
+        if (inserted.second) {
+          next.push_back(&inserted.first->first);
+          configurations++;
+        }
+      }
+    }
+
+    if (seen.size() > max_configurations) {
+      /* forget all but the last three depths; they have to fit in half
+         the room, so the next sweep is at least as many inserts away */
+      for(auto it=seen.begin(); it!=seen.end();) {
+        it = it->second + 1 < depth ? seen.erase(it) : std::next(it);
+      }
+      if (seen.size() > max_configurations / 2) {
+        return NondeterministicExecution { Outcome::Timeout, "", depth, configurations };
+      }
+    }
+    frontier.swap(next);
+  }
+  return NondeterministicExecution {
+    died ? Outcome::Undefined : Outcome::Loop, "", depth, configurations
+  };
+}
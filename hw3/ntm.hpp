@@ -0,0 +1,90 @@
+#ifndef _NTM_H_
+#define _NTM_H_
+
+#include "machine.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* Nondeterministic machines. A table starts with a line "N" and is then
+   laid out like a single tape table, one line per (state, symbol), except
+   that a line may list several transitions separated by "|":
+     1 # R | 2 0 L */
+struct NondeterministicTable {
+  int K;
+  int num_states;
+  int num_symbols;
+  /* the choices of (state, symbol) are choices[first[i]] up to
+     choices[first[i + 1]], i = state * num_symbols + symbol */
+  std::vector<uint32_t> first;
+  std::vector<Transition> choices;
+  std::vector<bool> halt;
+
+  /* reads from the "N" header on; throws table_error, see multitape.hpp */
+  static NondeterministicTable read(std::istream& is);
+};
+
+/* A tape cut into pages that configurations branched off each other
+   share: copying a tape copies the page pointers only, and a write copies
+   its page first if another tape still holds it. Pages that were never
+   written are null and read as blanks. The Zobrist key of the content is
+   kept up to date on every write. */
+class PagedTape {
+public:
+  static const int page_size = 64;
+
+  explicit PagedTape(const std::string& input);
+
+  long pos() const { return head; }
+  uint64_t key() const { return content_key; }
+
+  char read() const;
+  void write(char c);
+  void move(Move dir);
+
+  bool same_cells(const PagedTape& other) const;
+
+  /* non-blank extent of the tape, "#" if it is blank */
+  std::string as_string() const;
+
+private:
+  using Page = std::array<char, page_size>;
+
+  std::vector<std::shared_ptr<Page>> pages;
+  /* page number of pages[0]; page p holds positions p * page_size on */
+  long first_page;
+  long head;
+  uint64_t content_key;
+
+  static long page_of(long pos);
+  const Page* page(long number) const;
+};
+
+struct NondeterministicExecution {
+  Outcome outcome;
+  /* the tape of the halting branch, as PagedTape::as_string() */
+  std::string tape;
+  /* the depth of the search */
+  uint64_t steps;
+  /* distinct configurations explored */
+  size_t configurations;
+};
+
+/* Explores every branch breadth first and stops at the first branch in a
+   halting state, so that branch is one of the shortest. A configuration
+   seen before is not explored again. Configurations are remembered until
+   more than max_configurations are kept; then all but those of the last
+   three depths are forgotten, so a long deterministic run goes on like
+   run() and only repeats of older configurations are explored again.
+   When no branch is left the run is Undefined if some branch hit an
+   undefined transition and Loop otherwise. The step budget bounds the
+   depth; a run whose last three depths alone hold more than half of
+   max_configurations ends as Timeout. */
+NondeterministicExecution explore(const NondeterministicTable& table, const std::string& input,
+                                  const Limits& limits = Limits(),
+                                  size_t max_configurations = 1 << 22);
+
+#endif
@@ -0,0 +1,126 @@
+#include "optimize.hpp"
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+static Table fuse_stays(const Table& table) {
+  auto transitions = table.transitions;
+  for(int state=0; state<table.num_states; state++) {
+    if (table.is_halted(state)) continue;
+    for(int symbol=0; symbol<table.num_symbols; symbol++) {
+      auto transition = table.get(state, symbol);
+      /* (state, symbol) pairs of the chain; a repeat is a stay loop,
+         which stays one */
+      std::set<std::pair<int, int>> chain { { state, symbol } };
+      while (transition.valid() && transition.move_to() == Move::S
+             && !table.is_halted(transition.state_to())) {
+        auto next = transition.state_to();
+        auto read = transition.write_symbol();
+        if (!chain.insert({ next, read }).second) break;
+        auto following = table.get(next, read);
+        if (!following.valid()) break;
+        transition = following;
+      }
+      /* taking the last transition of the chain at once skips the stays,
+         whose writes it overwrites */
+      if (chain.size() > 1) {
+        transitions[state * table.num_symbols + symbol] = transition;
+      }
+    }
+  }
+  return Table(table.K, table.num_states, std::move(transitions), table.halt);
+}
+
+/* keeps state s as state keep[s] unless that is -1, sending transitions
+   into state t to target[t] */
+static Table renumber(const Table& table, const std::vector<int>& keep,
+                      const std::vector<int>& target, int count) {
+  std::vector<Transition> transitions(count * table.num_symbols);
+  std::vector<bool> halt(count);
+  for(int state=0; state<table.num_states; state++) {
+    if (keep[state] < 0) continue;
+    auto at = keep[state];
+    halt[at] = table.is_halted(state);
+    /* halting states never use their transitions */
+    for(int symbol=0; symbol<table.num_symbols && !halt[at]; symbol++) {
+      auto transition = table.get(state, symbol);
+      if (transition.valid()) {
+        transitions[at * table.num_symbols + symbol] = Transition(
+          target[transition.state_to()], transition.write_to(), transition.move_to());
+      }
+    }
+  }
+  return Table(table.K, count, std::move(transitions), std::move(halt));
+}
+
+static Table remove_unreachable(const Table& table) {
+  std::vector<int> number(table.num_states, -1);
+  std::vector<int> order { 0 };
+  number[0] = 0;
+  for(size_t i=0; i<order.size(); i++) {
+    auto state = order[i];
+    if (table.is_halted(state)) continue;
+    for(int symbol=0; symbol<table.num_symbols; symbol++) {
+      auto transition = table.get(state, symbol);
+      if (transition.valid() && number[transition.state_to()] < 0) {
+        number[transition.state_to()] = 0;
+        order.push_back(transition.state_to());
+      }
+    }
+  }
+  /* keep the original order of the states that stay */
+  int count = 0;
+  for(int state=0; state<table.num_states; state++) {
+    if (number[state] >= 0) number[state] = count++;
+  }
+  return renumber(table, number, number, count);
+}
+
+static Table merge_equivalent(const Table& table) {
+  /* block of every state, halting states in block 0 */
+  std::vector<int> block(table.num_states);
+  for(int state=0; state<table.num_states; state++) {
+    block[state] = table.is_halted(state) ? 0 : 1;
+  }
+  for(int blocks=0;;) {
+    using Signature = std::vector<std::tuple<bool, int, int, int>>;
+    std::map<std::pair<int, Signature>, int> blocks_of;
+    std::vector<int> refined(table.num_states);
+    for(int state=0; state<table.num_states; state++) {
+      Signature signature;
+      if (!table.is_halted(state)) {
+        for(int symbol=0; symbol<table.num_symbols; symbol++) {
+          auto transition = table.get(state, symbol);
+          signature.emplace_back(transition.valid(), transition.write_symbol(),
+                                 (int)transition.move_to(),
+                                 transition.valid() ? block[transition.state_to()] : -1);
+        }
+      }
+      auto key = std::make_pair(block[state], std::move(signature));
+      auto it = blocks_of.emplace(std::move(key), (int)blocks_of.size()).first;
+      refined[state] = it->second;
+    }
+    block.swap(refined);
+    if ((int)blocks_of.size() == blocks) break;
+    blocks = blocks_of.size();
+  }
+
+  /* one state per block, numbered by first appearance so state 0 stays */
+  std::map<int, int> numbers;
+  std::vector<int> keep(table.num_states, -1);
+  std::vector<int> target(table.num_states);
+  for(int state=0; state<table.num_states; state++) {
+    auto it = numbers.emplace(block[state], (int)numbers.size());
+    if (it.second) {
+      keep[state] = it.first->second;
+    }
+    target[state] = it.first->second;
+  }
+  return renumber(table, keep, target, numbers.size());
+}
+
+Table optimize(const Table& table) {
+  return merge_equivalent(remove_unreachable(fuse_stays(table)));
+}
@@ -0,0 +1,16 @@
+#ifndef _OPTIMIZE_H_
+#define _OPTIMIZE_H_
+
+#include "machine.hpp"
+
+/* Returns a table with the same final tape for every input, after
+   - fusing chains of S moves: a transition that stays and then takes a
+     defined transition from the next state becomes that transition;
+   - removing states unreachable from state 0;
+   - merging equivalent states by partition refinement: all halting
+     states are alike, and two other states are alike while every symbol
+     writes and moves the same way into alike states.
+   Runs take fewer steps; state 0 stays the initial state. */
+Table optimize(const Table& table);
+
+#endif
@@ -0,0 +1,88 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+
+Profile::Profile(const Table& table, uint64_t period)
+  : num_symbols(table.num_symbols), period(std::max<uint64_t>(period, 1)),
+    hits(table.num_states * table.num_symbols),
+    positions(64), origin(32) { }
+
+long Profile::grow(long pos) {
+  auto margin = std::max((long)positions.size(), std::abs(pos + origin) + 1);
+  std::vector<uint64_t> grown(positions.size() + 2 * margin);
+  std::copy(std::begin(positions), std::end(positions), std::begin(grown) + margin);
+  positions.swap(grown);
+  origin += margin;
+  return pos + origin;
+}
+
+void Profile::report(std::ostream& os, const Table& table, size_t rows) const {
+  uint64_t total = 0;
+  for(auto count: hits) total += count;
+  os << "samples " << total << ", about one every " << period << " steps\n";
+
+  std::vector<size_t> order;
+  for(size_t i=0; i<hits.size(); i++) {
+    if (hits[i] > 0) order.push_back(i);
+  }
+  std::sort(std::begin(order), std::end(order), [&](size_t a, size_t b) {
+    return hits[a] > hits[b];
+  });
+  os << "transitions (state symbol: samples share)\n";
+  /* the shares are fixed point; put the caller's format back after them */
+  auto flags = os.flags();
+  auto precision = os.precision();
+  for(size_t i=0; i<order.size() && i<rows; i++) {
+    auto index = order[i];
+    os << std::setw(8) << index / num_symbols << " "
+       << alphabets[index % num_symbols] << ": "
+       << std::setw(12) << hits[index] << " "
+       << std::fixed << std::setprecision(2)
+       << 100.0 * hits[index] / total << "%  "
+       << table.transitions[index] << '\n';
+  }
+  os.flags(flags);
+  os.precision(precision);
+
+  auto first = std::find_if(std::begin(positions), std::end(positions),
+                            [](uint64_t c) { return c > 0; });
+  if (first == std::end(positions)) {
+    return;
+  }
+  auto last = std::find_if(positions.rbegin(), positions.rend(),
+                           [](uint64_t c) { return c > 0; }).base();
+  long low = first - std::begin(positions) - origin;
+  long span = last - first;
+  long width = (span + rows - 1) / rows;
+  os << "head positions (from to: samples)\n";
+  for(long from=0; from<span; from+=width) {
+    uint64_t count = 0;
+    for(long i=from; i<std::min(span, from + width); i++) {
+      count += first[i];
+    }
+    os << std::setw(8) << low + from << " " << std::setw(8)
+       << low + std::min(span, from + width) - 1 << ": "
+       << std::setw(12) << count << '\n';
+  }
+}
+
+Trace::Trace(size_t capacity) {
+  size_t size = 1;
+  while (size < capacity) size *= 2;
+  records.resize(size);
+  mask = size - 1;
+}
+
+bool Trace::save(const std::string& path) const {
+  std::ofstream os { path, std::ios::binary };
+  uint64_t kept = std::min<uint64_t>(count, records.size());
+  os.write("TMTRACE1", 8);
+  os.write((const char*)&kept, sizeof(kept));
+  for(auto i=count - kept; i<count; i++) {
+    os.write((const char*)&records[i & mask], sizeof(Record));
+  }
+  return (bool)os;
+}
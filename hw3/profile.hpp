@@ -0,0 +1,89 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "machine.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* Transition hits per (state, symbol) and a histogram of head positions,
+   sampled about once per period steps. The gaps between samples are drawn
+   uniformly from 1 to 2 * period - 1, so machines that repeat with a
+   period of their own are not sampled in step with it. */
+class Profile {
+public:
+  explicit Profile(const Table& table, uint64_t period = 1);
+
+  bool sampled(uint64_t step) const {
+    return step >= next;
+  }
+
+  void record(uint64_t step, int state, int symbol, long pos) {
+    next = step + 1;
+    if (period > 1) {
+      random ^= random << 13;
+      random ^= random >> 7;
+      random ^= random << 17;
+      next += random % (2 * period - 1);
+    }
+    hits[state * num_symbols + symbol]++;
+    auto at = pos + origin;
+    if (at < 0 || at >= (long)positions.size()) {
+      at = grow(pos);
+    }
+    positions[at]++;
+  }
+
+  /* the hottest transitions and the head histogram in at most `rows`
+     buckets, as text */
+  void report(std::ostream& os, const Table& table, size_t rows = 32) const;
+
+private:
+  int num_symbols;
+  uint64_t period;
+  uint64_t next = 0;
+  uint64_t random = 0x9e3779b97f4a7c15ull;
+  std::vector<uint64_t> hits;
+  /* head position p is counted at positions[p + origin] */
+  std::vector<uint64_t> positions;
+  long origin;
+
+  long grow(long pos);
+};
+
+/* The last `capacity` steps of a run in a ring buffer, saved as
+     "TMTRACE1", uint64 record count, then the records oldest first
+   in host byte order */
+class Trace {
+public:
+  struct Record {
+    uint64_t step;
+    int64_t pos;
+    uint32_t state;
+    char read;
+    char write;
+    uint8_t move;
+    uint8_t unused;
+  };
+
+  /* capacity is rounded up to a power of two */
+  explicit Trace(size_t capacity);
+
+  void record(uint64_t step, long pos, int state, char read, const Transition& transition) {
+    records[count++ & mask] = Record {
+      step, pos, (uint32_t)state, read, transition.write_to(),
+      (uint8_t)transition.move_to(), 0
+    };
+  }
+
+  /* false on any I/O error */
+  bool save(const std::string& path) const;
+
+private:
+  std::vector<Record> records;
+  uint64_t mask;
+  uint64_t count = 0;
+};
+
+#endif
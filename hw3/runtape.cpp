@@ -0,0 +1,79 @@
+#include "runtape.hpp"
+
+#include <algorithm>
+
+RunTape::RunTape(const std::string& input)
+  : left('#'), right('#'), head('#'), pos(-1) {
+  /* like Tape, the head starts on the blank left of the input */
+  for(auto it=input.rbegin(); it!=input.rend(); it++) {
+    right.push(*it, 1);
+  }
+}
+
+Tape RunTape::to_tape() const {
+  std::string cells;
+  for(auto& run: left.all()) {
+    cells.append(run.count, run.symbol);
+  }
+  long first = pos - (long)cells.size();
+  cells.push_back(head);
+  for(auto it=right.all().rbegin(); it!=right.all().rend(); it++) {
+    cells.append(it->count, it->symbol);
+  }
+
+  /* Tape puts the cells at position 0; shift them to where they were */
+  Tape tape { cells };
+  tape.origin -= first;
+  tape.head = tape.cells.data() + tape.origin + pos;
+  return tape;
+}
+
+Execution run(const Table& table, RunTape tape, const Limits& limits,
+              int state, uint64_t steps) {
+  auto stop = [&](Outcome outcome) {
+    return Execution { outcome, tape.to_tape(), steps, state };
+  };
+
+  while (table.is_halted(state) == false) {
+    if (steps == limits.steps) {
+      return stop(Outcome::Timeout);
+    }
+    auto transition = table.get_transition(state, tape.head);
+    if (transition.valid() == false) {
+      return stop(Outcome::Undefined);
+    }
+    if (transition.move_to() == Move::S) {
+      tape.head = transition.write_to();
+      state = transition.state_to();
+      steps++;
+      continue;
+    }
+
+    auto right = transition.move_to() == Move::R;
+    auto& ahead = right ? tape.right : tape.left;
+    auto& behind = right ? tape.left : tape.right;
+    /* the head cell, and the run ahead of it too if the state stays */
+    uint64_t count = 1;
+    if (transition.state_to() == state && ahead.top() == tape.head) {
+      if (ahead.empty()) {
+        /* sweeping into the blank tape forever */
+        return stop(Outcome::Loop);
+      }
+      count += ahead.top_count();
+    }
+    count = std::min(count, limits.steps - steps);
+
+    behind.push(transition.write_to(), count);
+    ahead.take(count - 1);
+    tape.head = ahead.top();
+    ahead.take(1);
+    tape.pos += right ? (long)count : -(long)count;
+    state = transition.state_to();
+    steps += count;
+
+    if (tape.left.all().size() + tape.right.all().size() > limits.cells) {
+      return stop(Outcome::Timeout);
+    }
+  }
+  return stop(Outcome::Halted);
+}
@@ -0,0 +1,91 @@
+#ifndef _RUNTAPE_H_
+#define _RUNTAPE_H_
+
+#include "machine.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/* One side of a run-length encoded tape: runs of equal symbols, the top
+   of the stack next to the head. Past the bottom the tape is blank
+   forever, so blanks pushed onto an empty stack are dropped. */
+template <typename Symbol>
+class RunStack {
+public:
+  struct Run {
+    Symbol symbol;
+    uint64_t count;
+  };
+
+  explicit RunStack(Symbol blank): blank(blank) {}
+
+  bool empty() const { return runs.empty(); }
+
+  /* the symbol next to the head, blank past the bottom */
+  Symbol top() const { return runs.empty() ? blank : runs.back().symbol; }
+
+  /* length of the top run, 0 for the endless blanks past the bottom */
+  uint64_t top_count() const { return runs.empty() ? 0 : runs.back().count; }
+
+  /* symbols in all the runs */
+  uint64_t length() const { return total; }
+
+  void push(Symbol symbol, uint64_t count) {
+    if (runs.empty() && symbol == blank) {
+      return;
+    }
+    total += count;
+    if (!runs.empty() && runs.back().symbol == symbol) {
+      runs.back().count += count;
+      return;
+    }
+    runs.push_back(Run { symbol, count });
+  }
+
+  /* takes count symbols off the top run, at most its length; taking
+     blanks past the bottom changes nothing */
+  void take(uint64_t count) {
+    if (runs.empty()) {
+      return;
+    }
+    runs.back().count -= count;
+    total -= count;
+    if (runs.back().count == 0) {
+      runs.pop_back();
+    }
+  }
+
+  /* bottom first */
+  const std::vector<Run>& all() const { return runs; }
+
+private:
+  Symbol blank;
+  std::vector<Run> runs;
+  uint64_t total = 0;
+};
+
+/* Tape cells as runs on both sides of the head, which holds its own cell.
+   Memory grows with the number of runs, not the length of the tape. */
+struct RunTape {
+  RunStack<char> left, right;
+  char head;
+  long pos;
+
+  RunTape(const std::string& input);
+
+  /* the tape in the cell buffer form, with the head where it was */
+  Tape to_tape() const;
+};
+
+/* run() on a run-length encoded tape. When the transition on the head
+   symbol keeps the state and moves, the machine crosses the whole run of
+   that symbol ahead of it in one step, writing the new symbol over it;
+   a sweep costs one step per run instead of one per cell.
+   Crossing the endless blank tape that way ends as Loop even without
+   detect_loops. The step budget is exact; the cell budget counts runs.
+   No profile, trace or loop detector is kept. */
+Execution run(const Table& table, RunTape tape, const Limits& limits = Limits(),
+              int state = 0, uint64_t steps = 0);
+
+#endif
@@ -1,304 +1,229 @@
+#include "machine.hpp"
+#include "macro.hpp"
+#include "runtape.hpp"
+#include "checkpoint.hpp"
+#include "profile.hpp"
+#include "multitape.hpp"
+#include "ntm.hpp"
+#include "optimize.hpp"
+#include "assembler.hpp"
+#include "binary.hpp"
+
 #include <iostream>
 #include <string>
-#include <unordered_map>
-#include <cassert>
-#include <iterator>
-#include <vector>
-#include <algorithm>
+#include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <algorithm>
 
-/* Enable to print the intermediate transition */
-static bool debug_transition = false;
-
-/* Possible alphabets */
-static const char alphabets[] = "01#abcdefghijklmnopqrstuvwxyz";
-
-/* Possible movements */
-enum class Move {
-  S, R, L
-};
-
-std::ostream& operator<<(std::ostream &os, const Move& move) {
-  switch(move) {
-  case Move::S: os << "S"; break;
-  case Move::R: os << "R"; break;
-  case Move::L: os << "L"; break;
-  }
-  return os;
-}
-
-
-int to_digit(std::string word) {
-  return std::stoi(word);
-}
-
-Move to_move(std::string c) {
-  if (c.compare("S") == 0) { return Move::S; }
-  else if (c.compare("R") == 0) { return Move::R; }
-  else if (c.compare("L") == 0) { return Move::L; }
-  else { assert(false); }
-}
-
-char to_alphabet(std::string word, int count) {
-  assert(word.size() == 1);
-  auto c = word[0];
-  switch(c) {
-  case '0': case '1': case '#': return c;
-  default:
-    assert(c >= 'a' && c <= 'z');
-    assert((c-'a') < count);
-    return c;
-  }
-}
-
-struct Transition {
-  bool valid;
-  int state_to;
-  char write_to;
-  Move move_to;
-
-  Transition(): valid(false), state_to(0), write_to('\0'), move_to(Move::S) {}
-  Transition(int state_to, char change_to, Move move_to)
-    : valid(true), state_to(state_to), write_to(change_to), move_to(move_to)
-  {}
-
-  static Transition read(std::istream& is, int alphabet_count) {
-    std::string a, b, c;
-    is >> a >> b >> c;
-    /* first one is -, then it is infinite loop */
-    if (a.compare("-") == 0) {
-      assert(b.compare("-") == 0 && c.compare("-") == 0);
-      return Transition();
-    }
-    return Transition(to_digit(a),
-                      to_alphabet(b, alphabet_count),
-                      to_move(c));
-  }
-};
-
-std::ostream& operator<<(std::ostream &os, const Transition& tr) {
-  if (tr.valid) {
-    os << tr.state_to << " " << tr.write_to << " " << tr.move_to;
-  } else {
-    os << "- - -";
-  }
-  return os;
+static int usage(const char* name) {
+  std::cerr << "usage: " << name
+            << " [-a | -b table] [-O] [-m block_size | -r] [-l] [-k snapshot [-i seconds]] [-p period]"
+            << " [-t trace [-n records]]" << std::endl;
+  return 1;
 }
 
-struct Table {
-  int K;
-  std::vector<std::unordered_map<char, Transition>> state_transitions;
-  std::vector<bool> halt;
-
-  Table(int K, std::vector<std::unordered_map<char, Transition>> state_transitions, std::vector<bool> halt)
-    : K(K), state_transitions(state_transitions), halt(halt) { }
-
-  static Table read(std::istream &is) {
-    int K, N;
-    std::string halt_input;
-    std::cin >> K >> N >> halt_input;
-
-    std::vector<std::unordered_map<char, Transition>> state_transitions;
-    std::vector<bool> halt;
-    for(int i=0; i<N; i++) {
-      std::unordered_map<char, Transition> transitions;
-      for(int i=0; i < 3 + K; i++) {
-        transitions[alphabets[i]] = Transition::read(is, K);
-      }
-      state_transitions.push_back(transitions);
+/* a table, a labelled program with -a or a binary table file with -b */
+static Table read_table(bool assembling, const std::string& binary_path) {
+  if (!binary_path.empty()) {
+    Table table(0, 0, {}, {});
+    if (!load_table(binary_path, table)) {
+      std::cerr << binary_path << ": not a binary table" << std::endl;
+      exit(1);
     }
-    std::transform(std::begin(halt_input), std::end(halt_input),
-      std::back_inserter(halt), [&](auto c) {
-        switch(c) {
-        case '0': return false;
-        case '1': return true;
-        default: assert(false);
-        }
-      });
-    assert(state_transitions.size() == halt.size());
-    return Table(K, std::move(state_transitions), std::move(halt));
+    return table;
   }
-
-  Transition get_transition(int state, char a) const {
-    auto tr = state_transitions[state];
-    auto it = tr.find(a);
-    if (it != tr.end()) {
-      return it->second;
-    }
-    return Transition();
+  if (!assembling) {
+    return Table::read(std::cin);
   }
-
-  bool is_halted(int state) const {
-    return halt[state];
+  try {
+    return assemble(std::cin);
+  } catch (const assemble_error& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
   }
-};
+}
 
-std::ostream& operator<<(std::ostream &os, const Table& table) {
-  os << table.K << std::endl;
-  os << table.state_transitions.size() << std::endl;
-  for(bool h: table.halt) {
-    os << h;
+/* a table with several tapes, see multitape.hpp */
+static MultiTable read_multitable() {
+  try {
+    return MultiTable::read(std::cin);
+  } catch (const table_error& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
   }
-  os << std::endl;
-  bool first = true;
-  for(auto transitions: table.state_transitions) {
-    for(char ch: alphabets) {
-      auto it = transitions.find(ch);
-      if (it == transitions.end()) {
-        break;
-      }
-
-      if (first) { first = false; }
-      else {
-        os << std::endl;
-      }
+}
 
-      auto tr = it->second;
-      os << tr;
-    }
+/* a nondeterministic table, see ntm.hpp */
+static NondeterministicTable read_nondeterministic() {
+  try {
+    return NondeterministicTable::read(std::cin);
+  } catch (const table_error& e) {
+    std::cerr << e.what() << std::endl;
+    exit(1);
   }
-  return os;
 }
 
-struct Tape {
-  int pos;
-  int left_end;
-  int right_end;
-  std::unordered_map<int, char> tape;
-
-  Tape(std::string input)
-    : pos(-1), left_end(0), right_end(std::max((int)input.size()-1, 0)) {
-    for(size_t i=0; i < input.size(); i++) {
-      tape[i] = input[i];
-    }
+int main(int argc, char* argv[]) {
+  if (std::getenv("DEBUG_TRANSITION") != nullptr) {
+    debug_transition = true;
   }
-
-  char get(int i) const {
-    auto at = tape.find(i);
-    if (at == tape.end()) {
-      return '#';
+  /* -a reads a labelled program instead of a table, -b loads the table
+     from a binary file and reads only the input, -O optimizes the
+     table first, -m k runs on blocks of k cells, -r on a run-length
+     encoded tape, -l exits on a detected loop, -k keeps
+     a snapshot of the run every -i seconds and resumes from it if it
+     exists, -p prints a profile sampled every given number of steps to
+     stderr and -t saves the last -n steps */
+  bool assembling = false;
+  std::string binary_path;
+  bool optimizing = false;
+  int block_size = 0;
+  bool runs = false;
+  Limits limits;
+  std::string snapshot_path;
+  double interval = 10;
+  uint64_t profile_period = 0;
+  std::string trace_path;
+  size_t trace_records = 1 << 16;
+  for(int i=1; i<argc; i++) {
+    if (std::strcmp(argv[i], "-a") == 0) {
+      assembling = true;
+    } else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      binary_path = argv[++i];
+    } else if (std::strcmp(argv[i], "-O") == 0) {
+      optimizing = true;
+    } else if (std::strcmp(argv[i], "-l") == 0) {
+      limits.detect_loops = true;
+    } else if (std::strcmp(argv[i], "-r") == 0) {
+      runs = true;
+    } else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      block_size = std::atoi(argv[++i]);
+      if (block_size < 1 || block_size > MacroMachine::max_block_size) {
+        std::cerr << "block size must be between 1 and "
+                  << MacroMachine::max_block_size << std::endl;
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      snapshot_path = argv[++i];
+    } else if (std::strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      interval = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      profile_period = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+    } else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      trace_records = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      return usage(argv[0]);
     }
-    return at->second;
-  }
-
-  char read() const {
-    return get(pos);
   }
-
-  void write(char c) {
-    /* write non-empty char */
-    if (c != '#') {
-      tape[pos] = c;
-      /* extends left_end, right_end bound */
-      if (pos < left_end) {
-        left_end = pos;
-      } else if (pos > right_end) {
-        right_end = pos;
-      }
-      return;
+  if (assembling && !binary_path.empty()) {
+    std::cerr << "-a and -b cannot be combined" << std::endl;
+    return 1;
+  }
+  if (block_size > 0 && runs) {
+    std::cerr << "-m and -r cannot be combined" << std::endl;
+    return 1;
+  }
+  if ((block_size > 0 || runs)
+      && (!snapshot_path.empty() || profile_period > 0 || !trace_path.empty())) {
+    std::cerr << "snapshots, profiles and traces are not supported with -m or -r" << std::endl;
+    return 1;
+  }
+  if ((block_size > 0 || runs) && limits.detect_loops) {
+    std::cerr << "-l is not supported with -m or -r" << std::endl;
+    return 1;
+  }
+  /* a snapshot numbers the states of the table it was taken with */
+  if (optimizing && !snapshot_path.empty()) {
+    std::cerr << "-O and -k cannot be combined" << std::endl;
+    return 1;
+  }
+  /* a "T" header marks a machine with several tapes, an "N" header a
+     nondeterministic one */
+  auto header = assembling || !binary_path.empty() ? 0 : (std::cin >> std::ws).peek();
+  if ((header == 'T' || header == 'N')
+      && (block_size > 0 || runs || !snapshot_path.empty() || profile_period > 0
+          || !trace_path.empty() || limits.detect_loops || optimizing)) {
+    std::cerr << "only plain runs are supported with several tapes"
+              << " or nondeterministic machines" << std::endl;
+    return 1;
+  }
+  if (header == 'N') {
+    auto table = read_nondeterministic();
+    std::string input;
+    std::cin >> input;
+    auto result = explore(table, input, limits);
+    if (result.outcome != Outcome::Halted) {
+      exit(-1);
     }
-    /* write empty-char */
-    tape.erase(pos);
-    /* contract left_end, right_end bound until it fits*/
-    if (pos == left_end) {
-      while(left_end < right_end && get(left_end) == '#') {
-        left_end++;
-      }
-    } else if (pos == right_end) {
-      while(left_end < right_end && get(right_end) == '#') {
-        right_end--;
-      }
+    std::cout << result.tape << std::endl;
+    return 0;
+  }
+  if (header == 'T') {
+    auto table = read_multitable();
+    std::string input;
+    std::cin >> input;
+    auto result = run(table, MultiTape { table.tapes, input, table.tracks }, limits);
+    if (result.outcome != Outcome::Halted) {
+      exit(-1);
     }
-  }
-
-  void move(Move dir) {
-    switch(dir) {
-    case Move::S: return;
-    case Move::L: pos--; return;
-    case Move::R: pos++; return;
+    /* print every tape; tracks over the same cells */
+    for(int i=0; i<result.tapes.count; i++) {
+      std::cout << result.tapes.as_string(i) << '\n';
     }
+    return 0;
   }
 
-  std::string as_string() const {
-    std::string str;
-    for(int i=left_end; i<=right_end; i++) {
-      str.push_back(get(i));
-    }
-    return str;
+  /* read table */
+  auto table = read_table(assembling, binary_path);
+  if (optimizing) {
+    table = optimize(table);
   }
-};
-
-std::ostream& operator<<(std::ostream& os, const Tape& tape) {
-  for(int i=std::min(tape.pos, tape.left_end); i<= std::max(tape.pos, tape.right_end); i++) {
-    if (i == tape.left_end && i == tape.right_end) {
-      os << "x";
-    } else if (i == tape.left_end) {
-      os << "l";
-    } else if (i == tape.right_end) {
-      os << "r";
-    } else {
-      os << " ";
-    }
+  std::unique_ptr<Profile> profile;
+  std::unique_ptr<Trace> trace;
+  if (profile_period > 0) {
+    profile.reset(new Profile(table, profile_period));
+    limits.profile = profile.get();
   }
-  os << std::endl;
-  for(int i=std::min(tape.pos, tape.left_end); i<= std::max(tape.pos, tape.right_end); i++) {
-    os << tape.get(i);
+  if (!trace_path.empty()) {
+    trace.reset(new Trace(trace_records));
+    limits.trace = trace.get();
   }
-  os << std::endl;
+  /* initialize tape */
+  std::string input;
+  std::cin >> input;
 
-  for(int i=std::min(tape.pos, tape.left_end); i<= std::max(tape.pos, tape.right_end); i++) {
-    if (i == tape.pos) {
-      os << "^";
-    } else {
-      os << " ";
+  Execution result { Outcome::Undefined, Tape(""), 0, 0 };
+  if (block_size > 0) {
+    result = MacroMachine(table, block_size).run(input, limits);
+  } else if (runs) {
+    result = run(table, RunTape { input }, limits);
+  } else if (!snapshot_path.empty()) {
+    Snapshot start { 0, 0, Tape { input } };
+    if (std::ifstream(snapshot_path)) {
+      if (!load_snapshot(snapshot_path, start)
+          || start.state < 0 || start.state >= table.num_states) {
+        std::cerr << snapshot_path << ": not a snapshot of this machine" << std::endl;
+        return 1;
+      }
     }
+    result = run_checkpointed(table, std::move(start), limits, snapshot_path, interval);
+  } else {
+    result = run(table, Tape { input }, limits);
   }
-  return os;
-}
-
-Tape run(const Table& table, Tape tape) {
-  if (debug_transition) {
-    std::cout << tape << std::endl;
+  if (profile) {
+    profile->report(std::cerr, table);
   }
-
-  int state = 0;
-  while (table.is_halted(state) == false) {
-    /* read tape */
-    auto read = tape.read();
-
-    /* read transitioon table */
-    auto transition = table.get_transition(state, read);
-    if (transition.valid == false) {
-      /* it is infinite loop. exit with error */
-      exit(-1);
-    }
-
-    /* write it, move header, update state */
-    tape.write(transition.write_to);
-    tape.move(transition.move_to);
-    state = transition.state_to;
-
-    if (debug_transition) {
-      std::cout << transition << std::endl;
-      std::cout << tape << std::endl;
-    }
+  if (trace && !trace->save(trace_path)) {
+    std::cerr << trace_path << ": cannot write the trace" << std::endl;
   }
-  /* return final state tape */
-  return tape;
-}
-
-int main() {
-  if (std::getenv("DEBUG_TRANSITION") != nullptr) {
-    debug_transition = true;
+  if (result.outcome != Outcome::Halted) {
+    /* it is infinite loop. exit with error */
+    exit(-1);
   }
-  /* read table */
-  auto table = Table::read(std::cin);
-  /* initialize tape */
-  std::string input;
-  std::cin >> input;
-  Tape tape { input };
-
-  auto result = run(table, tape);
   /* print tape */
-  std::cout << result.as_string() << std::endl;
+  std::cout << result.tape.as_string() << std::endl;
 }
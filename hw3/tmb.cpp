@@ -0,0 +1,55 @@
+#include "machine.hpp"
+#include "macro.hpp"
+#include "batch.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+
+/* Reads a table and then one input per word, runs them all and prints
+   "<outcome> <steps> <tape>" per input in order:
+     tmb [-j threads] [-s max_steps] [-c max_cells] [-m block_size] [-l]
+   where -l stops runs proven to loop */
+int main(int argc, char* argv[]) {
+  Limits limits;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int block_size = 0;
+  for(int i=1; i<argc; i++) {
+    if (i + 1 < argc && std::strcmp(argv[i], "-j") == 0) {
+      threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (i + 1 < argc && std::strcmp(argv[i], "-s") == 0) {
+      limits.steps = std::strtoull(argv[++i], nullptr, 10);
+    } else if (i + 1 < argc && std::strcmp(argv[i], "-c") == 0) {
+      limits.cells = std::strtoull(argv[++i], nullptr, 10);
+    } else if (i + 1 < argc && std::strcmp(argv[i], "-m") == 0) {
+      block_size = std::atoi(argv[++i]);
+      if (block_size < 1 || block_size > MacroMachine::max_block_size) {
+        std::cerr << "block size must be between 1 and "
+                  << MacroMachine::max_block_size << std::endl;
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "-l") == 0) {
+      limits.detect_loops = true;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [-j threads] [-s max_steps] [-c max_cells] [-m block_size] [-l]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  auto table = Table::read(std::cin);
+  std::vector<std::string> inputs;
+  for(std::string input; std::cin >> input;) {
+    inputs.push_back(input);
+  }
+
+  auto results = run_batch(table, inputs, limits, threads, block_size);
+  for(auto& result: results) {
+    std::cout << result.outcome << " " << result.steps << " "
+              << result.tape.as_string() << "\n";
+  }
+}
@@ -0,0 +1,17 @@
+#include "machine.hpp"
+#include "compiler.hpp"
+#include "optimize.hpp"
+
+#include <iostream>
+#include <cstring>
+
+/* Reads a table and writes a C++ simulator specialized to it, optimized
+   first with -O:
+     tmc < TM1.txt > tm1.cpp && g++ -O2 -o tm1 tm1.cpp && ./tm1 < TM1.in */
+int main(int argc, char* argv[]) {
+  auto table = Table::read(std::cin);
+  if (argc > 1 && std::strcmp(argv[1], "-O") == 0) {
+    table = optimize(table);
+  }
+  compile(table, std::cout);
+}
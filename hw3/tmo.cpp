@@ -0,0 +1,10 @@
+#include "machine.hpp"
+#include "optimize.hpp"
+
+#include <iostream>
+
+/* Reads a table and prints the optimized table in the same format */
+int main() {
+  auto table = Table::read(std::cin);
+  std::cout << optimize(table) << std::endl;
+}
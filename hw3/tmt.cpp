@@ -0,0 +1,28 @@
+#include "machine.hpp"
+#include "binary.hpp"
+
+#include <iostream>
+#include <cstring>
+
+/* Converts between the text and binary table formats, see binary.hpp:
+     tmt TM1.tmt < TM1.txt    reads a text table and writes it in binary
+     tmt -d TM1.tmt           prints a binary table as text */
+int main(int argc, char* argv[]) {
+  if (argc == 3 && std::strcmp(argv[1], "-d") == 0) {
+    Table table(0, 0, {}, {});
+    if (!load_table(argv[2], table)) {
+      std::cerr << argv[2] << ": not a binary table" << std::endl;
+      return 1;
+    }
+    std::cout << table << '\n';
+    return 0;
+  }
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " [-d] table" << std::endl;
+    return 1;
+  }
+  if (!save_table(argv[1], Table::read(std::cin))) {
+    std::cerr << argv[1] << ": cannot write the table" << std::endl;
+    return 1;
+  }
+}